@@ -0,0 +1,47 @@
+#pragma once
+#include "PlatformTypes.h"
+#include <vector>
+
+//Keeps track of the processes we start, reaping them when they exit and reporting the exit as soon as it happens
+//On Linux each child gets a pidfd, so signals can't reach an unrelated process that inherited a reused pid
+class childSupervisor
+{
+    struct child
+    {
+        processId pid = 0;
+        //-1 if the kernel doesn't support pidfds, in which case we fall back to the pid
+        int pidfd = -1;
+    };
+
+    std::vector<child> children;
+    //Children that have been reaped but not yet collected
+    std::vector<processId> exited;
+    //Groups every pidfd into one descriptor that can be waited on
+    int source = -1;
+
+    childSupervisor() = default;
+    ~childSupervisor();
+
+    void reap();
+
+public:
+    childSupervisor(const childSupervisor&) = delete;
+    childSupervisor& operator=(const childSupervisor&) = delete;
+
+    static childSupervisor& get();
+
+    //Starts supervising a process we have just started
+    void track(processId pid);
+
+    //Returns a file descriptor that becomes readable when a supervised process exits, or -1 if there isn't one
+    int eventSource() const { return source; }
+
+    //Reaps any supervised processes that have exited and returns them, each exit is only returned once
+    std::vector<processId> collectExited();
+
+    //Returns true if the process is one of ours and hasn't exited yet
+    bool running(processId pid);
+
+    //Sends a signal to the process, through its pidfd if it is one of ours
+    void signal(processId pid, int sig);
+};
@@ -0,0 +1,261 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sol/sol.hpp>
+#include "osmanip/manipulators/colsty.hpp"
+#include "Settings.h"
+
+//A file watch as written in the configuration
+struct watchSpec
+{
+    std::string file;
+    sol::protected_function onUpdate;
+};
+
+//One page of a window's playlist
+struct playlistEntry
+{
+    std::string url;
+    //How long the page is shown before moving on to the next
+    std::chrono::milliseconds dwell{ 0 };
+
+    bool operator==(const playlistEntry&) const = default;
+};
+
+//An enabled window as written in the configuration, with its monitor already decided
+struct windowSpec
+{
+    //The window's key in the configuration table
+    int key = 0;
+    //Optional name that identifies the window across reloads, empty if not given
+    std::string id;
+    std::string url;
+    int monitor = -1;
+    bool forceLoad = false;
+    bool cacheBuster = false;
+    //Zero uses the global refresh time
+    std::chrono::milliseconds interval{ 0 };
+    sol::protected_function onTick;
+    sol::protected_function onOpen;
+    sol::protected_function onUnhealthy;
+    std::vector<watchSpec> watches;
+    //Pages shown in turn, empty if the window only shows its url
+    std::vector<playlistEntry> playlist;
+};
+
+//Everything read from Kiosk.lua, compiled once per load so nothing else needs to walk the lua tables
+//Snapshots are never changed once compiled, a reload compiles a new one and swaps it in
+struct configSnapshot
+{
+    std::shared_ptr<const appSettings> settings;
+    //The configuration's own tick function
+    sol::protected_function onTick;
+    //Ordered by monitor
+    std::vector<windowSpec> windows;
+
+private:
+    static void warn(const std::string& message)
+    {
+        std::cout << osm::feat(osm::col, "orange") << "Warning: " << message << "\n" << osm::feat(osm::rst, "all");
+    }
+
+    //Returns nothing if the window is disabled or invalid
+    static std::optional<windowSpec> compileWindow(const sol::object& key, const sol::table& table)
+    {
+        bool enabled = false;
+        auto enabledFunc = table.get_or<sol::protected_function>("Enabled", {});
+        if (enabledFunc.valid())
+        {
+            auto result = enabledFunc();
+            if (!result.valid())
+            {
+                sol::error error = result;
+                std::cout << osm::feat(osm::col, "orange") << "Failed to run Enabled function: " << error.what() << ".\n" << osm::feat(osm::rst, "all");
+                return std::nullopt;
+            }
+            enabled = result;
+        }
+        else
+        {
+            enabled = table["Enabled"].get_or(true);
+        }
+        if (!enabled)
+            return std::nullopt;
+
+        if (!key.is<int>())
+        {
+            warn("Process key \"" + key.as<std::string>() + "\" is not an integer. It will not be considered.");
+            return std::nullopt;
+        }
+
+        windowSpec spec;
+        spec.key = key.as<int>();
+        if (auto playlist = table["Playlist"].get_or<sol::table>({}); playlist.valid())
+        {
+            for (size_t i = 1; i <= playlist.size(); ++i)
+            {
+                if (playlist[i].get_type() != sol::type::table || playlist[i]["Url"].get_type() != sol::type::string)
+                {
+                    warn("Playlist entry " + std::to_string(i) + " of process " + std::to_string(spec.key) + " has no Url. It will not be considered.");
+                    continue;
+                }
+                sol::table entry = playlist[i];
+                auto dwell = entry.get_or("Dwell", 30.0);
+                if (dwell <= 0)
+                {
+                    warn("Playlist entry " + std::to_string(i) + " of process " + std::to_string(spec.key) + " has no positive Dwell, 30 seconds will be used instead.");
+                    dwell = 30;
+                }
+                spec.playlist.push_back({ entry["Url"].get<std::string>(), std::chrono::milliseconds(static_cast<long long>(dwell * 1000)) });
+            }
+        }
+        if (!spec.playlist.empty())
+        {
+            //The playlist starts at its first page, whatever the url says
+            spec.url = spec.playlist.front().url;
+        }
+        else if (table["Url"].get_type() == sol::type::string)
+        {
+            spec.url = table["Url"].get<std::string>();
+        }
+        else
+        {
+            warn("Process " + std::to_string(spec.key) + " has no Url. It will not be considered.");
+            return std::nullopt;
+        }
+        if (table["Id"].get_type() == sol::type::string)
+            spec.id = table["Id"].get<std::string>();
+        else if (table["Id"].get_type() == sol::type::number)
+            spec.id = std::to_string(table["Id"].get<long long>());
+        else if (table["Id"].valid())
+            warn("Process " + std::to_string(spec.key) + " has an Id that is not a string or number. It will be ignored.");
+        spec.monitor = table.get_or("Monitor", -1);
+        spec.forceLoad = table.get_or("ForceLoad", false);
+        spec.cacheBuster = table.get_or("CacheBuster", false);
+        auto interval = table.get_or("Interval", 0.0);
+        if (interval < 0)
+        {
+            warn("Process " + std::to_string(spec.key) + " has a negative Interval, RefreshTime will be used instead.");
+            interval = 0;
+        }
+        spec.interval = std::chrono::milliseconds(static_cast<long long>(interval * 1000));
+        spec.onTick = table.get_or("OnTick", sol::protected_function{});
+        spec.onOpen = table.get_or("OnOpen", sol::protected_function{});
+        spec.onUnhealthy = table.get_or("OnUnhealthy", sol::protected_function{});
+
+        if (auto toWatch = table["Watches"].get_or<sol::table>({}); toWatch.valid())
+        {
+            for (auto& w : toWatch)
+            {
+                if (w.second.get_type() != sol::type::table)
+                {
+                    warn("A watch of process " + std::to_string(spec.key) + " is not a table. It will not be considered.");
+                    continue;
+                }
+                auto watch = w.second.as<sol::table>();
+                spec.watches.push_back({ watch.get_or<std::string>("File", ""), watch.get_or<sol::protected_function>("OnUpdate", {}) });
+            }
+        }
+        return spec;
+    }
+
+public:
+    //Reads the settings and the chosen configuration, settings missing from the file keep their previous values
+    static std::shared_ptr<const configSnapshot> compile(sol::state& lua, const appSettings& previous)
+    {
+        auto result = std::make_shared<configSnapshot>();
+        auto settings = std::make_shared<appSettings>(previous);
+        settings->loadFromTable(lua);
+        result->settings = settings;
+
+        sol::table data = lua["Configurations"][settings->configuration].get_or(sol::table{});
+        if (!data.valid())
+            throw std::runtime_error("Configurations table not found.");
+
+        result->onTick = data["OnTick"];
+
+        for (auto& [k, v] : data)
+        {
+            //If this isn't a table, skip it
+            if (v.get_type() != sol::type::table)
+                continue;
+            if (auto spec = compileWindow(k, v.as<sol::table>()))
+                result->windows.push_back(std::move(*spec));
+        }
+
+        auto& windows = result->windows;
+        //Order by insertion
+        std::sort(windows.begin(), windows.end(), [](const auto& a, const auto& b) { return a.key < b.key; });
+
+        //For every window with an unspecified monitor, give it the first unused monitor
+        for (auto& w : windows)
+        {
+            if (w.monitor != -1)
+                continue;
+            int index = 0;
+            while (std::any_of(windows.begin(), windows.end(), [&](const auto& other) { return other.monitor == index; }))
+                index++;
+            w.monitor = index;
+        }
+
+        //Remove any with a monitor index greater than the monitor count
+        std::erase_if(windows, [&](const auto& w) { return w.monitor >= settings->monitors || w.monitor < 0; });
+
+        //Sort by monitor
+        std::sort(windows.begin(), windows.end(), [](const auto& a, const auto& b) { return a.monitor < b.monitor; });
+        return result;
+    }
+};
+
+//Holds the snapshot in use, for the main thread only
+//Snapshots hold references into the lua state, so they must be released on the thread that owns it, and before it is destroyed
+//Other threads read the settings through appSettings::snapshot(), which holds nothing from lua
+class configStore
+{
+    std::shared_ptr<const configSnapshot> snapshot;
+
+    configStore() = default;
+public:
+    static configStore& get()
+    {
+        static configStore store;
+        return store;
+    }
+
+    //Keep hold of the returned pointer for as long as the snapshot is needed, it won't change underneath
+    std::shared_ptr<const configSnapshot> current() const
+    {
+        return snapshot;
+    }
+
+    //Swaps in a new snapshot, the old one lives on until nothing refers to it
+    void publish(std::shared_ptr<const configSnapshot> next)
+    {
+        appSettings::publish(next->settings);
+        snapshot = std::move(next);
+    }
+
+    //Drops the snapshot, the settings stay published as they hold nothing from lua
+    void clear()
+    {
+        snapshot.reset();
+    }
+};
+
+//Clears the store once it goes out of scope, declared after the lua state so the snapshot goes first (even when unwinding from an error)
+class configStoreScope
+{
+public:
+    configStoreScope() = default;
+    configStoreScope(const configStoreScope&) = delete;
+    configStoreScope& operator=(const configStoreScope&) = delete;
+    ~configStoreScope()
+    {
+        configStore::get().clear();
+    }
+};
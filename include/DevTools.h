@@ -0,0 +1,258 @@
+#pragma once
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "osmanip/manipulators/colsty.hpp"
+#include "Json.h"
+#include "PlatformTypes.h"
+
+//The pipes a browser is started with for --remote-debugging-pipe
+//The browser reads commands from its fd 3 and writes replies and events to its fd 4
+struct devToolsPipe
+{
+    int commandsRead = -1;
+    int commandsWrite = -1;
+    int messagesRead = -1;
+    int messagesWrite = -1;
+};
+
+//A DevTools protocol connection to one browser, used to navigate and reload its page without restarting it
+//Messages are JSON objects ended by a NUL, page commands go through a session attached to the browser's first tab
+class devToolsChannel
+{
+public:
+    //Called with the command's result, or with the error message if it failed
+    using replyHandler = std::function<void(const jsonValue& result, std::optional<std::string_view> error)>;
+
+private:
+    int toBrowser = -1;
+    int fromBrowser = -1;
+    std::string incoming;
+    //Written out as the pipe accepts it, so a busy browser never holds us up
+    std::string outgoing;
+    bool broken = false;
+
+    int nextId = 1;
+    std::map<int, replyHandler> waiting;
+
+    //Session for the page, empty until we have attached to it
+    std::string sessionId;
+    bool attaching = false;
+    //Page commands sent before we were attached, sent once we are
+    struct pageCommand
+    {
+        std::string method;
+        std::string params;
+        replyHandler onReply;
+    };
+    std::vector<pageCommand> deferred;
+
+    //Load events seen since the channel opened, and whether the current page has finished loading
+    size_t loads = 0;
+    bool loaded = false;
+
+    //Platform specific, both return false once the pipe has closed
+    bool flush();
+    bool receive();
+
+    void send(std::string_view method, std::string_view params, const std::string& session, replyHandler onReply)
+    {
+        const int id = nextId++;
+        if (onReply)
+            waiting.emplace(id, std::move(onReply));
+        outgoing += "{\"id\":" + std::to_string(id) + ",\"method\":" + jsonValue::quote(method);
+        if (!params.empty())
+            outgoing += ",\"params\":" + std::string(params);
+        if (!session.empty())
+            outgoing += ",\"sessionId\":" + jsonValue::quote(session);
+        outgoing += "}";
+        outgoing += '\0';
+        if (!flush())
+            broken = true;
+    }
+
+    void sendToPage(std::string method, std::string params, replyHandler onReply = {})
+    {
+        if (sessionId.empty())
+        {
+            deferred.push_back({ std::move(method), std::move(params), std::move(onReply) });
+            return;
+        }
+        send(method, params, sessionId, std::move(onReply));
+    }
+
+    void attach(std::string_view targetId)
+    {
+        attaching = true;
+        send("Target.attachToTarget", "{\"targetId\":" + jsonValue::quote(targetId) + ",\"flatten\":true}", {},
+            [this](const jsonValue& result, std::optional<std::string_view> error)
+            {
+                attaching = false;
+                auto session = result["sessionId"].asString();
+                if (error || !session)
+                    return;
+                sessionId = *session;
+                sendToPage("Page.enable", {});
+                //The page may have loaded before we were listening for it
+                checkReadyState();
+                for (auto& command : std::exchange(deferred, {}))
+                    sendToPage(std::move(command.method), std::move(command.params), std::move(command.onReply));
+            });
+    }
+
+    void checkReadyState()
+    {
+        evaluate("document.readyState", [this](const jsonValue& value, std::optional<std::string_view> error)
+        {
+            if (!error && value.asString() == "complete")
+                loaded = true;
+        });
+    }
+
+    void dispatch(const jsonValue& message)
+    {
+        if (auto id = message["id"].asNumber())
+        {
+            auto it = waiting.find(static_cast<int>(*id));
+            if (it == waiting.end())
+                return;
+            auto onReply = std::move(it->second);
+            waiting.erase(it);
+            if (!message["error"].isNull())
+                onReply(message["result"], message["error"]["message"].asString().value_or("unknown error"));
+            else
+                onReply(message["result"], std::nullopt);
+            return;
+        }
+
+        const auto method = message["method"].asString().value_or("");
+        const auto& params = message["params"];
+        if (method == "Target.targetCreated" || method == "Target.targetInfoChanged")
+        {
+            const auto& info = params["targetInfo"];
+            if (sessionId.empty() && !attaching && info["type"].asString() == "page")
+                if (auto target = info["targetId"].asString())
+                    attach(*target);
+        }
+        else if (method == "Target.detachedFromTarget")
+        {
+            //The tab closed, the next page to appear is attached to instead
+            if (params["sessionId"].asString() == sessionId)
+                sessionId.clear();
+        }
+        else if (method == "Page.loadEventFired" && message["sessionId"].asString() == sessionId)
+        {
+            loads++;
+            loaded = true;
+        }
+    }
+
+public:
+    devToolsChannel(int toBrowser, int fromBrowser) : toBrowser(toBrowser), fromBrowser(fromBrowser)
+    {
+        //Tells us about the tabs that already exist, and any opened later
+        send("Target.setDiscoverTargets", "{\"discover\":true}", {}, {});
+    }
+    ~devToolsChannel();
+    devToolsChannel(const devToolsChannel&) = delete;
+    devToolsChannel& operator=(const devToolsChannel&) = delete;
+
+    int eventSource() const { return fromBrowser; }
+
+    //Reads and handles everything the browser has sent, returns false once the browser has gone
+    bool update()
+    {
+        if (broken || !receive() || !flush())
+        {
+            broken = true;
+            return false;
+        }
+        size_t end;
+        while ((end = incoming.find('\0')) != std::string::npos)
+        {
+            auto message = jsonValue::parse(std::string_view(incoming).substr(0, end));
+            incoming.erase(0, end + 1);
+            if (message)
+                dispatch(*message);
+        }
+        return !broken;
+    }
+
+    //Whether commands reach the page straight away, rather than once the page has been found
+    bool isAttached() const { return !broken && !sessionId.empty(); }
+    bool isBroken() const { return broken; }
+    //Whether the page has fired its load event since it last started loading
+    bool isLoaded() const { return loaded; }
+    size_t loadCount() const { return loads; }
+
+    void navigate(const std::string& url)
+    {
+        loaded = false;
+        sendToPage("Page.navigate", "{\"url\":" + jsonValue::quote(url) + "}");
+    }
+
+    void reload(bool ignoreCache = false)
+    {
+        loaded = false;
+        sendToPage("Page.reload", ignoreCache ? "{\"ignoreCache\":true}" : "{}");
+    }
+
+    //Runs the expression in the page, the handler is given the value it returned
+    void evaluate(const std::string& expression, replyHandler onResult)
+    {
+        sendToPage("Runtime.evaluate", "{\"expression\":" + jsonValue::quote(expression) + ",\"returnByValue\":true}",
+            [onResult = std::move(onResult)](const jsonValue& result, std::optional<std::string_view> error)
+            {
+                if (!error && !result["exceptionDetails"].isNull())
+                    error = result["exceptionDetails"]["text"].asString().value_or("exception");
+                onResult(result["result"]["value"], error);
+            });
+    }
+};
+
+//Every DevTools channel, found by the process of the browser on the other end
+//On Linux, every channel's pipe is grouped into one descriptor that can be waited on
+class devTools
+{
+    std::vector<std::pair<processId, std::unique_ptr<devToolsChannel>>> channels;
+    int source = -1;
+
+    devTools() = default;
+    ~devTools();
+
+public:
+    devTools(const devTools&) = delete;
+    devTools& operator=(const devTools&) = delete;
+
+    static devTools& get();
+
+    //Creates the pipes for a browser about to be started, or nothing if the platform doesn't support them
+    std::optional<devToolsPipe> createPipe();
+    //The browser's ends of the pipe, in the order they should be given to it (as fd 3 and 4)
+    static std::vector<int> browserEnds(const devToolsPipe& pipe) { return { pipe.commandsRead, pipe.messagesWrite }; }
+    //Opens the channel to a browser started with the pipe, or closes the pipe if the browser failed to start
+    void open(processId pid, const devToolsPipe& pipe);
+
+    //The channel to the given browser, or nullptr if it doesn't have a working one
+    devToolsChannel* find(processId pid)
+    {
+        for (auto& [p, channel] : channels)
+        {
+            if (p == pid && pid > 0 && !channel->isBroken())
+                return channel.get();
+        }
+        return nullptr;
+    }
+
+    //Returns a file descriptor that becomes readable when a browser sends something, or -1 if there isn't one
+    int eventSource() const { return source; }
+
+    //Handles everything the browsers have sent, dropping channels to browsers that have gone
+    void update();
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <X11/Xlib.h>
+#include <string>
+#include <unordered_map>
+
+//Owns the single X connection shared by the whole kiosk
+//The connection is opened lazily and reopened if the X server goes away
+class displaySession
+{
+    Display* display = nullptr;
+    //Atoms are only valid for the connection they were interned on, so this is cleared on reconnect
+    std::unordered_map<std::string, Atom> atoms;
+    //Set by the IO error handler once the connection is no longer usable
+    bool lost = false;
+    //Incremented every time a new connection is made
+    size_t generation = 0;
+
+    displaySession() = default;
+    ~displaySession();
+
+    void connect();
+    void disconnect();
+
+    static void onConnectionLost(Display* display, void* userData);
+
+public:
+    displaySession(const displaySession&) = delete;
+    displaySession& operator=(const displaySession&) = delete;
+
+    static displaySession& get();
+
+    //Returns the shared connection, reconnecting if it was lost. Returns nullptr if no server is available
+    Display* handle();
+
+    //Returns the named atom, interning it on first use
+    //If onlyIfExists is set and the atom does not exist yet, None is returned and nothing is cached
+    Atom atom(const std::string& name, bool onlyIfExists = true);
+
+    //Returns the default root window, or None if there is no connection
+    Window root();
+
+    //Can be compared between calls to detect that the connection (and any per-connection state) was replaced
+    size_t getGeneration() const { return generation; }
+};
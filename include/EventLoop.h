@@ -0,0 +1,61 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+//Waits on every event source in the kiosk at once (window system, file watches, child processes and timers) and dispatches each to its handler
+//On Linux this is built on epoll and timerfd, so the kiosk sleeps until something actually happens
+class eventLoop
+{
+public:
+    using handler = std::function<void()>;
+    //Returns true if a source already has work queued that its descriptor won't report
+    using pendingCheck = std::function<bool()>;
+    using timerId = size_t;
+
+private:
+    struct watcher
+    {
+        handler onReady;
+        pendingCheck pending;
+    };
+
+    struct timer
+    {
+        timerId id = 0;
+        std::chrono::steady_clock::time_point due;
+        //Zero for a timer that only fires once
+        std::chrono::milliseconds interval{ 0 };
+        handler onDue;
+    };
+
+    std::unordered_map<int, watcher> watchers;
+    std::vector<timer> timers;
+    timerId lastTimer = 0;
+    //epoll and timerfd descriptors (Linux only)
+    int source = -1;
+    int timerSource = -1;
+
+    //When the earliest timer is due, if there are any
+    std::optional<std::chrono::steady_clock::time_point> firstTimerDue() const;
+    void runDueTimers();
+
+public:
+    eventLoop();
+    ~eventLoop();
+    eventLoop(const eventLoop&) = delete;
+    eventLoop& operator=(const eventLoop&) = delete;
+
+    //Calls the handler whenever the descriptor becomes readable (or the pending check says there is work), replacing any existing handler
+    void watch(int fd, handler onReady, pendingCheck pending = {});
+    void unwatch(int fd);
+
+    //Calls the handler once the delay has passed, then every interval if one is given
+    timerId addTimer(std::chrono::milliseconds delay, handler onDue, std::chrono::milliseconds interval = std::chrono::milliseconds(0));
+    void removeTimer(timerId id);
+
+    //Waits for something to happen (or the timeout, if it isn't negative) and runs the handlers for everything that is ready
+    void runOnce(std::chrono::milliseconds timeout = std::chrono::milliseconds(-1));
+};
@@ -1,53 +1,104 @@
 #pragma once
 #include <string_view>
 #include <filesystem>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <optional>
+#include <chrono>
 #include <sol/sol.hpp>
 #include "osmanip/manipulators/colsty.hpp"
+#include "LuaScheduler.h"
+#include "ConfigSnapshot.h"
 
 class process;
 
+//A file tracked by the watch registry, shared between every watch on the same path
+struct watchedFile
+{
+    std::filesystem::path path;
+    std::filesystem::file_time_type lastWrite = std::filesystem::file_time_type::min();
+    //Incremented each time a (coalesced) change to the file is seen
+    size_t version = 0;
+
+    //Platform bookkeeping, only touched by the registry
+    int directoryWatch = -1;
+    std::optional<std::chrono::steady_clock::time_point> pendingSince;
+};
+
+//Tracks changes to every watched file in the kiosk
+//On Linux this is backed by inotify, so unchanged files cost nothing, elsewhere files are checked once per update
+class fileWatchRegistry
+{
+    std::vector<std::weak_ptr<watchedFile>> files;
+    //inotify descriptor and watched directories (Linux only)
+    int source = -1;
+    std::unordered_map<int, std::filesystem::path> directories;
+
+    fileWatchRegistry() = default;
+    ~fileWatchRegistry();
+
+    void watchDirectory(watchedFile& file);
+    //Stats the file and bumps its version if it was written to, returns true if it changed
+    static bool refresh(watchedFile& file);
+
+public:
+    //Writes are only reported once a file has been quiet for this long, so a burst of writes becomes one update
+    static constexpr auto settleTime = std::chrono::milliseconds(50);
+
+    fileWatchRegistry(const fileWatchRegistry&) = delete;
+    fileWatchRegistry& operator=(const fileWatchRegistry&) = delete;
+
+    static fileWatchRegistry& get();
+
+    //Starts tracking the given file, watches on the same file share the returned record
+    std::shared_ptr<const watchedFile> watch(const std::filesystem::path& path);
+
+    //Returns a file descriptor that becomes readable when a watched file changes, or -1 if there isn't one
+    int eventSource() const { return source; }
+
+    //Returns when a pending change will have settled, if there is one
+    std::optional<std::chrono::steady_clock::time_point> nextDeadline() const;
+
+    //Applies any pending changes without blocking, returns true if a watched file changed
+    bool update();
+};
+
 //Binds a function to a file change
 class luaWatch
 {
     std::string filePath;
     sol::protected_function onUpdate;
-    std::filesystem::file_time_type lastTime = std::filesystem::file_time_type::min();
+    std::shared_ptr<const watchedFile> file;
+    size_t seenVersion = 0;
 public:
-    void check(process& proc)
+    //The description names the window, for error messages and the callback profile
+    void check(process& proc, std::string_view description)
     {
-        if (!std::filesystem::exists(filePath))
+        //Watches can be used for cachebusting, so the change is consumed even if there's no function set
+        if (!file || file->version == seenVersion)
         {
             return;
         }
-        auto newTime = std::filesystem::last_write_time(filePath);
-        if (newTime > lastTime)
-        {
-            //Watches can be used for cachebusting, so even if there's no function set we can assume the watch is here for the cache buster and the time should still be tracked
-            lastTime = newTime;
-            if (onUpdate.valid())
-            {
-                auto result = onUpdate(std::ref(proc));
-                if (!result.valid())
-                {
-                    sol::error error = result;
-                    std::cout << osm::feat(osm::col, "orange") << "Failed to run watch function: " << error.what() << ".\n" << osm::feat(osm::rst, "all");
-                }
-            }
-		}
+        seenVersion = file->version;
+        luaScheduler::get().run(&proc, this, "watch function (" + filePath + ") for " + std::string(description), onUpdate, std::ref(proc));
     }
 
     std::filesystem::file_time_type getLastFileWrite() const
     {
-		return lastTime;
+		return file ? file->lastWrite : std::filesystem::file_time_type::min();
 	}
 
-    static luaWatch loadFromTable(const sol::table& table)
+    static luaWatch fromSpec(const watchSpec& spec)
 	{
 		luaWatch result;
-		result.filePath = table.get_or<std::string>("File", "");
-        result.onUpdate = table.get_or<sol::protected_function>("OnUpdate", {});
-        if (std::filesystem::exists(result.filePath))
-            result.lastTime = std::filesystem::last_write_time(result.filePath);
+		result.filePath = spec.file;
+        result.onUpdate = spec.onUpdate;
+        if (!result.filePath.empty())
+        {
+            result.file = fileWatchRegistry::get().watch(result.filePath);
+            result.seenVersion = result.file->version;
+        }
 		return result;
 	}
-};
\ No newline at end of file
+};
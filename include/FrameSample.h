@@ -0,0 +1,202 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "Rect.h"
+#include "Settings.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KIOSK_FRAME_SSE2
+#include <emmintrin.h>
+#endif
+
+//A summary of what was on screen in an area, compared between samples to tell whether the window is still drawing
+struct frameSample
+{
+    //The area shrunk to a grid of cells, each the average brightness (0-255) of the pixels in it
+    static constexpr int gridSize = 16;
+    std::array<std::uint8_t, gridSize * gridSize> cells{};
+    //Whether the whole area is (nearly) one colour
+    bool blank = false;
+
+    //How many cells are noticeably brighter or darker than in the other sample
+    //Small changes (antialiasing, a blinking caret) are averaged away by the cell they are in, so don't count
+    int distance(const frameSample& other) const
+    {
+        //How far a cell's brightness can move before it counts as changed
+        static constexpr int cellTolerance = 3;
+        int changed = 0;
+        for (size_t i = 0; i < cells.size(); ++i)
+            changed += std::abs(cells[i] - other.cells[i]) > cellTolerance;
+        return changed;
+    }
+};
+
+//Summarises a 32 bit per pixel frame, reading every other row
+//Pixels are taken 16 bytes at a time, so the channels of four pixels are handled together
+inline frameSample summariseFrame(const std::uint8_t* pixels, int width, int height, std::ptrdiff_t stride)
+{
+    //How far apart the colours can be for the frame to still count as blank
+    static constexpr int blankTolerance = 8;
+    static constexpr int grid = frameSample::gridSize;
+
+    //The total of every channel, and the number of pixels, read in each cell
+    std::array<std::uint64_t, grid * grid> sums{};
+    std::array<std::uint32_t, grid * grid> counts{};
+    //The smallest and largest value seen at each byte of a 16 byte block, byte n holds channel n % 4
+    alignas(16) std::uint8_t lowest[16];
+    alignas(16) std::uint8_t highest[16];
+    std::fill(std::begin(lowest), std::end(lowest), std::uint8_t(255));
+    std::fill(std::begin(highest), std::end(highest), std::uint8_t(0));
+
+    width = std::max(width, 0);
+#ifdef KIOSK_FRAME_SSE2
+    __m128i low = _mm_load_si128(reinterpret_cast<const __m128i*>(lowest));
+    __m128i high = _mm_load_si128(reinterpret_cast<const __m128i*>(highest));
+    const __m128i zero = _mm_setzero_si128();
+    //Leaves out the fourth byte of each pixel, which is padding (or alpha) and says nothing about what is shown
+    const __m128i colours = _mm_set1_epi32(0x00FFFFFF);
+#endif
+    for (int y = 0; y < height; y += 2)
+    {
+        const std::uint8_t* row = pixels + y * stride;
+        const int cellRow = y * grid / height;
+        for (int column = 0; column < grid; ++column)
+        {
+            const size_t cell = static_cast<size_t>(cellRow * grid + column);
+            const size_t end = static_cast<size_t>(width * (column + 1) / grid) * 4;
+            size_t i = static_cast<size_t>(width * column / grid) * 4;
+            counts[cell] += static_cast<std::uint32_t>((end - i) / 4);
+#ifdef KIOSK_FRAME_SSE2
+            __m128i total = zero;
+            for (; i + 16 <= end; i += 16)
+            {
+                const __m128i block = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i)), colours);
+                low = _mm_min_epu8(low, block);
+                high = _mm_max_epu8(high, block);
+                //Sums each half of the block into its own 64 bit lane
+                total = _mm_add_epi64(total, _mm_sad_epu8(block, zero));
+            }
+            alignas(16) std::uint64_t lanes[2];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), total);
+            sums[cell] += lanes[0] + lanes[1];
+#endif
+            for (; i < end; ++i)
+            {
+                if (i % 4 == 3)
+                    continue;
+                lowest[i % 16] = std::min(lowest[i % 16], row[i]);
+                highest[i % 16] = std::max(highest[i % 16], row[i]);
+                sums[cell] += row[i];
+            }
+        }
+    }
+#ifdef KIOSK_FRAME_SSE2
+    //Folded in with whatever the scalar tails saw
+    alignas(16) std::uint8_t vectorLowest[16];
+    alignas(16) std::uint8_t vectorHighest[16];
+    _mm_store_si128(reinterpret_cast<__m128i*>(vectorLowest), low);
+    _mm_store_si128(reinterpret_cast<__m128i*>(vectorHighest), high);
+    for (int b = 0; b < 16; ++b)
+    {
+        lowest[b] = std::min(lowest[b], vectorLowest[b]);
+        highest[b] = std::max(highest[b], vectorHighest[b]);
+    }
+#endif
+
+    frameSample sample;
+    for (size_t cell = 0; cell < sums.size(); ++cell)
+    {
+        //Cells of areas smaller than the grid can be empty, and stay black
+        if (counts[cell] > 0)
+            sample.cells[cell] = static_cast<std::uint8_t>(sums[cell] / (counts[cell] * 3ull));
+    }
+
+    std::uint8_t channelLowest[3] = { 255, 255, 255 };
+    std::uint8_t channelHighest[3] = { 0, 0, 0 };
+    for (int b = 0; b < 16; ++b)
+    {
+        const int channel = b % 4;
+        if (channel == 3)
+            continue;
+        channelLowest[channel] = std::min(channelLowest[channel], lowest[b]);
+        channelHighest[channel] = std::max(channelHighest[channel], highest[b]);
+    }
+    sample.blank = true;
+    for (int c = 0; c < 3; ++c)
+        sample.blank = sample.blank && channelHighest[c] - channelLowest[c] <= blankTolerance;
+    return sample;
+}
+
+//A copy of what was on screen in an area, as rows of 32 bit BGRX pixels with no padding
+struct capturedFrame
+{
+    int width = 0;
+    int height = 0;
+    std::vector<std::uint8_t> pixels;
+
+    static capturedFrame copy(const std::uint8_t* source, int width, int height, std::ptrdiff_t stride)
+    {
+        capturedFrame frame{ width, height, {} };
+        const size_t rowBytes = static_cast<size_t>(width) * 4;
+        frame.pixels.resize(rowBytes * static_cast<size_t>(height));
+        for (int y = 0; y < height; ++y)
+            std::copy_n(source + y * stride, rowBytes, frame.pixels.data() + rowBytes * y);
+        return frame;
+    }
+};
+
+//Platform specific
+//Samples what is on screen in each area (in desktop coordinates), nothing is returned for areas that couldn't be read
+std::vector<std::optional<frameSample>> sampleFrames(std::span<const rect> areas);
+//Copies what is on screen in the area (in desktop coordinates), or nothing if it couldn't be read
+std::optional<capturedFrame> captureArea(rect area);
+
+//Tracks a window's samples, noticing once it has stopped drawing or gone blank
+class frameHealth
+{
+    std::optional<frameSample> last;
+    int unchanged = 0;
+    int blank = 0;
+    //Set once a problem has been reported, so it is only reported again after the window recovers
+    bool reported = false;
+
+public:
+    //Forgets the samples so far, for when the window or its page has changed
+    void reset()
+    {
+        *this = {};
+    }
+
+    //Returns what is wrong once the window has been frozen or blank for HealthCheck's sample counts, once per problem
+    std::optional<std::string_view> record(const frameSample& sample)
+    {
+        const auto& settings = appSettings::get();
+        unchanged = last && last->distance(sample) == 0 ? unchanged + 1 : 0;
+        last = sample;
+        blank = sample.blank ? blank + 1 : 0;
+
+        std::optional<std::string_view> problem;
+        if (settings.healthBlankSamples > 0 && blank >= settings.healthBlankSamples)
+            problem = "blank";
+        //Frozen once that many samples in a row showed no noticeable change
+        else if (settings.healthFrozenSamples > 1 && unchanged + 1 >= settings.healthFrozenSamples)
+            problem = "frozen";
+
+        if (!problem)
+        {
+            reported = false;
+            return std::nullopt;
+        }
+        if (reported)
+            return std::nullopt;
+        reported = true;
+        return problem;
+    }
+};
@@ -0,0 +1,144 @@
+#pragma once
+#include <chrono>
+#include <csignal>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include "ChildSupervisor.h"
+#include "DevTools.h"
+#include "PageReadiness.h"
+#include "PlatformTypes.h"
+#include "ProcessManagement.h"
+#include "Settings.h"
+#include "WindowEvents.h"
+#include "WindowQuery.h"
+
+//A browser window kept minimised while it loads a page, so it can be shown once the page is ready
+//Used to load a playlist's next page out of sight, and to hold the page it replaces until the new one is in place
+class hiddenWindow
+{
+    //Set while we are waiting for a browser we started to open its window
+    std::optional<pendingLaunch> launching;
+    std::chrono::steady_clock::time_point deadline;
+    processId pid = 0;
+    windowHandle handle = 0;
+    std::string url;
+
+public:
+    hiddenWindow() = default;
+    hiddenWindow(const hiddenWindow&) = delete;
+    hiddenWindow& operator=(const hiddenWindow&) = delete;
+    hiddenWindow(hiddenWindow&& other) noexcept
+        : launching(std::exchange(other.launching, std::nullopt)), deadline(other.deadline),
+        pid(std::exchange(other.pid, 0)), handle(std::exchange(other.handle, 0)), url(std::move(other.url)) {}
+    hiddenWindow& operator=(hiddenWindow&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            launching = std::exchange(other.launching, std::nullopt);
+            deadline = other.deadline;
+            pid = std::exchange(other.pid, 0);
+            handle = std::exchange(other.handle, 0);
+            url = std::move(other.url);
+        }
+        return *this;
+    }
+    ~hiddenWindow()
+    {
+        close();
+    }
+
+    bool empty() const { return !launching && handle == 0; }
+    windowHandle getHandle() const { return handle; }
+    const std::string& getUrl() const { return url; }
+
+    //Starts a browser for the url in the background, returns false if the platform can't (in which case nothing is preloaded)
+    bool start(const std::string& newUrl)
+    {
+        close();
+        //Only an isolated browser's window can be told apart (and closed) once it appears, anything else would be left open as a stray
+        if (!appSettings::get().isolateWindows)
+            return false;
+        launching = beginLaunch(newUrl, offscreenLaunchArgs());
+        if (!launching)
+            return false;
+        url = newUrl;
+        deadline = std::chrono::steady_clock::now() + std::chrono::seconds(appSettings::get().launchTimeout);
+        return true;
+    }
+
+    //Takes charge of a window that is still showing, so it can be closed (or reused) once it has been covered
+    void hold(processId heldPid, windowHandle heldHandle, std::string heldUrl)
+    {
+        close();
+        pid = heldPid;
+        handle = heldHandle;
+        url = std::move(heldUrl);
+    }
+
+    //Hides the window and sends it to another page, returns false if it can't be sent (without DevTools)
+    bool recycle(const std::string& newUrl)
+    {
+        auto channel = handle != 0 ? devTools::get().find(pid) : nullptr;
+        if (!channel || !channel->isAttached())
+            return false;
+        minimiseWindow(handle);
+        channel->navigate(newUrl);
+        url = newUrl;
+        return true;
+    }
+
+    //Looks for the started browser's window, returns false if it didn't appear in time
+    bool update(std::span<const windowHandle> known, std::chrono::steady_clock::time_point now)
+    {
+        if (!launching)
+            return true;
+        auto found = findLaunchedWindows({ &*launching, 1 }, known).front();
+        if (found)
+        {
+            pid = found->first;
+            handle = found->second;
+            launching.reset();
+            minimiseWindow(handle);
+            //Title changes wake us up to check whether the page has loaded
+            watchWindow(handle);
+            return true;
+        }
+        if (now < deadline)
+            return true;
+        close();
+        return false;
+    }
+
+    //Whether the window's page has loaded, judged the same way as for OnOpen
+    bool isReady(const windowState& state) const
+    {
+        if (handle == 0 || !state.exists)
+            return false;
+        if (auto channel = devTools::get().find(pid))
+            return channel->isLoaded();
+        return titleShowsLoaded(state.title, url);
+    }
+
+    //Hands the window over to be shown, leaving this empty
+    std::pair<processId, windowHandle> release()
+    {
+        auto result = std::pair{ std::exchange(pid, 0), std::exchange(handle, 0) };
+        url.clear();
+        return result;
+    }
+
+    void close()
+    {
+        if (launching)
+            closeLaunch(*launching);
+        else if (pid > 0 && childSupervisor::get().running(pid))
+            childSupervisor::get().signal(pid, SIGTERM);
+        launching.reset();
+        pid = 0;
+        handle = 0;
+        url.clear();
+    }
+};
@@ -0,0 +1,209 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "PlatformTypes.h"
+#include "Settings.h"
+#include "Trace.h"
+
+//One keypress, typed character or click sent to a window
+struct inputAction
+{
+    enum class kind { key, character, click };
+    kind type = kind::key;
+    //For keys, along with the modifiers held while it is pressed
+    keycode key = 0;
+    bool shift = false;
+    bool control = false;
+    bool alt = false;
+    //For typed characters, a unicode code point
+    char32_t character = 0;
+    //For clicks, 1 (left), 2 (right) or 3 (middle)
+    int x = 0;
+    int y = 0;
+    int button = 1;
+};
+
+//A sequence of input for one window, sent in order with KeyTimeMs between each action
+//The window is focused once at the start of the batch rather than for every action
+class inputBatch
+{
+    processId pid = 0;
+    windowHandle target = 0;
+    std::vector<inputAction> actions;
+
+    friend class inputQueue;
+
+public:
+    inputBatch(processId pid, windowHandle target) : pid(pid), target(target) {}
+
+    bool empty() const { return actions.empty(); }
+
+    inputBatch& press(keycode key, bool shift = false, bool control = false, bool alt = false)
+    {
+        if (key != 0)
+            actions.push_back({ .type = inputAction::kind::key, .key = key, .shift = shift, .control = control, .alt = alt });
+        return *this;
+    }
+
+    //Types the (UTF-8) text a character at a time, whatever the keyboard layout
+    inputBatch& type(std::string_view text)
+    {
+        for (size_t i = 0; i < text.size();)
+        {
+            const auto lead = static_cast<unsigned char>(text[i]);
+            const size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+            //Invalid bytes are skipped rather than typed as something else
+            if (length == 0 || i + length > text.size())
+            {
+                i++;
+                continue;
+            }
+            char32_t point = length == 1 ? lead : lead & (0x7F >> length);
+            bool valid = true;
+            for (size_t k = 1; k < length; ++k)
+            {
+                const auto next = static_cast<unsigned char>(text[i + k]);
+                valid = valid && (next & 0xC0) == 0x80;
+                point = (point << 6) | (next & 0x3F);
+            }
+            i += valid ? length : 1;
+            if (valid)
+                actions.push_back({ .type = inputAction::kind::character, .character = point });
+        }
+        return *this;
+    }
+
+    inputBatch& click(int x, int y, int button = 1)
+    {
+        actions.push_back({ .type = inputAction::kind::click, .x = x, .y = y, .button = button });
+        return *this;
+    }
+};
+
+//Platform specific
+//Raises and focuses the window ready for input, returns false if the window can't take it
+bool focusForInput(processId pid, windowHandle target);
+//Queues the action to be sent to the (focused) window
+//Returns false if it can't go until the window has handled what was sent before it, in which case it is sent again after a short gap
+bool sendInput(windowHandle target, const inputAction& action);
+//Sends everything queued by sendInput
+void flushInput();
+//Undoes any temporary changes made to send input (e.g. keys remapped to type characters the layout doesn't have)
+void releaseInput();
+
+//Sends batches of input one after another, spacing their actions by KeyTimeMs without ever waiting for it
+//There is only one keyboard and mouse, so batches for different windows are never interleaved
+//Only one queue exists, and the main loop wakes up for it when its next action is due
+class inputQueue
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+private:
+    struct queued
+    {
+        inputBatch batch;
+        size_t next = 0;
+    };
+    std::deque<queued> batches;
+    clock::time_point nextAction;
+    //When temporary changes are undone, once the window has had time to handle the last of the input
+    std::optional<clock::time_point> releaseAt;
+    static constexpr auto releaseDelay = std::chrono::seconds(1);
+    //How long an action that had to wait for the window is held back for, even if KeyTimeMs is 0
+    //Long enough for the window to handle what was sent before it (e.g. presses of keys that need binding again)
+    static constexpr auto retryDelay = std::chrono::milliseconds(50);
+
+    inputQueue() = default;
+
+public:
+    inputQueue(const inputQueue&) = delete;
+    inputQueue& operator=(const inputQueue&) = delete;
+
+    static inputQueue& get()
+    {
+        static inputQueue queue;
+        return queue;
+    }
+
+    //Queues the batch behind any already being sent, its first action goes straight away if nothing is
+    void submit(inputBatch batch)
+    {
+        if (batch.empty() || batch.target == 0)
+            return;
+        batches.push_back({ std::move(batch) });
+        update();
+    }
+
+    //Drops anything still to be sent to the window, e.g. because it is closing
+    void cancel(windowHandle target)
+    {
+        if (target == 0)
+            return;
+        //The batch being sent is stopped where it is
+        std::erase_if(batches, [&](const queued& q) { return q.batch.target == target; });
+    }
+
+    //Sends every action that is due
+    void update()
+    {
+        const auto now = clock::now();
+        const auto gap = std::chrono::milliseconds(std::max(appSettings::get().keyTimeMs, 0));
+        bool sent = false;
+        while (!batches.empty() && now >= nextAction)
+        {
+            auto& current = batches.front();
+            if (current.next == 0)
+            {
+                //Anything still queued for the previous window goes before the focus moves
+                if (sent)
+                    flushInput();
+                if (!focusForInput(current.batch.pid, current.batch.target))
+                {
+                    batches.pop_front();
+                    continue;
+                }
+            }
+            {
+                traceSpan span("send input");
+                if (!sendInput(current.batch.target, current.batch.actions[current.next]))
+                {
+                    //What went before is flushed below, this is sent again once the window has had time for it
+                    nextAction = now + std::max<clock::duration>(gap, retryDelay);
+                    break;
+                }
+                current.next++;
+            }
+            sent = true;
+            if (current.next == current.batch.actions.size())
+                batches.pop_front();
+            if (gap.count() > 0)
+            {
+                nextAction = now + gap;
+                break;
+            }
+        }
+        if (sent)
+        {
+            flushInput();
+            releaseAt = now + releaseDelay;
+        }
+        else if (batches.empty() && releaseAt && now >= *releaseAt)
+        {
+            releaseInput();
+            releaseAt.reset();
+        }
+    }
+
+    //When update next has something to do, or nothing if the queue is idle
+    std::optional<clock::time_point> nextDue() const
+    {
+        if (!batches.empty())
+            return nextAction;
+        return releaseAt;
+    }
+};
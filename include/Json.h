@@ -0,0 +1,298 @@
+#pragma once
+#include <charconv>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+//Just enough JSON for talking to the browser: parsing its messages and escaping strings we send
+class jsonValue
+{
+public:
+    using array = std::vector<jsonValue>;
+    using object = std::map<std::string, jsonValue, std::less<>>;
+
+private:
+    //Arrays and objects are held by pointer, as the value can't contain itself directly
+    std::variant<std::nullptr_t, bool, double, std::string, std::shared_ptr<array>, std::shared_ptr<object>> value = nullptr;
+
+    struct parser
+    {
+        std::string_view text;
+        size_t pos = 0;
+
+        void skipSpace()
+        {
+            while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+                pos++;
+        }
+
+        bool consume(char c)
+        {
+            skipSpace();
+            if (pos < text.size() && text[pos] == c)
+            {
+                pos++;
+                return true;
+            }
+            return false;
+        }
+
+        bool consumeWord(std::string_view word)
+        {
+            if (text.substr(pos, word.size()) != word)
+                return false;
+            pos += word.size();
+            return true;
+        }
+
+        static void appendUtf8(std::string& out, unsigned code)
+        {
+            if (code < 0x80)
+                out += static_cast<char>(code);
+            else if (code < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (code >> 6));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+            else if (code < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | (code >> 12));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xF0 | (code >> 18));
+                out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+        }
+
+        std::optional<unsigned> hex4()
+        {
+            if (pos + 4 > text.size())
+                return std::nullopt;
+            unsigned code = 0;
+            auto [end, error] = std::from_chars(text.data() + pos, text.data() + pos + 4, code, 16);
+            if (error != std::errc() || end != text.data() + pos + 4)
+                return std::nullopt;
+            pos += 4;
+            return code;
+        }
+
+        std::optional<std::string> parseString()
+        {
+            if (!consume('"'))
+                return std::nullopt;
+            std::string result;
+            while (pos < text.size())
+            {
+                char c = text[pos++];
+                if (c == '"')
+                    return result;
+                if (c != '\\')
+                {
+                    result += c;
+                    continue;
+                }
+                if (pos >= text.size())
+                    return std::nullopt;
+                switch (text[pos++])
+                {
+                case '"': result += '"'; break;
+                case '\\': result += '\\'; break;
+                case '/': result += '/'; break;
+                case 'b': result += '\b'; break;
+                case 'f': result += '\f'; break;
+                case 'n': result += '\n'; break;
+                case 'r': result += '\r'; break;
+                case 't': result += '\t'; break;
+                case 'u':
+                {
+                    auto code = hex4();
+                    if (!code)
+                        return std::nullopt;
+                    //Characters outside the basic plane come as a surrogate pair
+                    if (*code >= 0xD800 && *code < 0xDC00 && consumeWord("\\u"))
+                    {
+                        auto low = hex4();
+                        if (!low)
+                            return std::nullopt;
+                        *code = 0x10000 + ((*code - 0xD800) << 10) + (*low - 0xDC00);
+                    }
+                    appendUtf8(result, *code);
+                    break;
+                }
+                default:
+                    return std::nullopt;
+                }
+            }
+            return std::nullopt;
+        }
+
+        std::optional<jsonValue> parseValue(int depth = 0)
+        {
+            //Nothing we talk to nests this deep, so anything that does is treated as broken
+            if (depth > 64)
+                return std::nullopt;
+            skipSpace();
+            if (pos >= text.size())
+                return std::nullopt;
+
+            jsonValue result;
+            const char c = text[pos];
+            if (c == '{')
+            {
+                pos++;
+                auto members = std::make_shared<object>();
+                if (!consume('}'))
+                {
+                    do
+                    {
+                        skipSpace();
+                        auto key = parseString();
+                        if (!key || !consume(':'))
+                            return std::nullopt;
+                        auto member = parseValue(depth + 1);
+                        if (!member)
+                            return std::nullopt;
+                        members->insert_or_assign(std::move(*key), std::move(*member));
+                    } while (consume(','));
+                    if (!consume('}'))
+                        return std::nullopt;
+                }
+                result.value = std::move(members);
+            }
+            else if (c == '[')
+            {
+                pos++;
+                auto elements = std::make_shared<array>();
+                if (!consume(']'))
+                {
+                    do
+                    {
+                        auto element = parseValue(depth + 1);
+                        if (!element)
+                            return std::nullopt;
+                        elements->push_back(std::move(*element));
+                    } while (consume(','));
+                    if (!consume(']'))
+                        return std::nullopt;
+                }
+                result.value = std::move(elements);
+            }
+            else if (c == '"')
+            {
+                auto s = parseString();
+                if (!s)
+                    return std::nullopt;
+                result.value = std::move(*s);
+            }
+            else if (consumeWord("true"))
+                result.value = true;
+            else if (consumeWord("false"))
+                result.value = false;
+            else if (consumeWord("null"))
+                result.value = nullptr;
+            else
+            {
+                double number = 0;
+                auto [end, error] = std::from_chars(text.data() + pos, text.data() + text.size(), number);
+                if (error != std::errc())
+                    return std::nullopt;
+                pos = end - text.data();
+                result.value = number;
+            }
+            return result;
+        }
+    };
+
+public:
+    //Returns nothing if the text isn't valid JSON
+    static std::optional<jsonValue> parse(std::string_view text)
+    {
+        parser p{ text };
+        auto result = p.parseValue();
+        p.skipSpace();
+        if (!result || p.pos != text.size())
+            return std::nullopt;
+        return result;
+    }
+
+    //Quotes and escapes the string for use in a message
+    static std::string quote(std::string_view s)
+    {
+        std::string result = "\"";
+        for (unsigned char c : s)
+        {
+            switch (c)
+            {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (c < 0x20)
+                {
+                    static constexpr char digits[] = "0123456789abcdef";
+                    result += "\\u00";
+                    result += digits[c >> 4];
+                    result += digits[c & 0xF];
+                }
+                else
+                {
+                    result += static_cast<char>(c);
+                }
+            }
+        }
+        return result + "\"";
+    }
+
+    bool isNull() const { return std::holds_alternative<std::nullptr_t>(value); }
+    bool isObject() const { return std::holds_alternative<std::shared_ptr<object>>(value); }
+
+    //The member with the given name, or null if there isn't one (or this isn't an object)
+    const jsonValue& operator[](std::string_view key) const
+    {
+        static const jsonValue none;
+        auto members = std::get_if<std::shared_ptr<object>>(&value);
+        if (!members)
+            return none;
+        auto it = (*members)->find(key);
+        return it == (*members)->end() ? none : it->second;
+    }
+
+    const array& elements() const
+    {
+        static const array none;
+        auto items = std::get_if<std::shared_ptr<array>>(&value);
+        return items ? **items : none;
+    }
+
+    std::optional<std::string_view> asString() const
+    {
+        if (auto s = std::get_if<std::string>(&value))
+            return *s;
+        return std::nullopt;
+    }
+
+    std::optional<double> asNumber() const
+    {
+        if (auto n = std::get_if<double>(&value))
+            return *n;
+        return std::nullopt;
+    }
+
+    std::optional<bool> asBool() const
+    {
+        if (auto b = std::get_if<bool>(&value))
+            return *b;
+        return std::nullopt;
+    }
+};
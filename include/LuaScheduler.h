@@ -0,0 +1,375 @@
+#pragma once
+#include <sol/sol.hpp>
+#include "osmanip/manipulators/colsty.hpp"
+#include "Settings.h"
+#include "Trace.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+//Runs lua callbacks as coroutines, so they can wait (with Sleep, WaitForWindow and WaitForFile) without holding up everything else
+//Waiting callbacks are resumed by the main loop once whatever they are waiting for has happened
+//Each run between waits is held to the callback budgets in the settings, and timed for the profile
+//Only one scheduler exists at a time, and it must be destroyed before the lua state it runs on
+class luaScheduler
+{
+public:
+    using clock = std::chrono::steady_clock;
+    //Whatever a callback belongs to (a window, or the configuration), so its callbacks can be cancelled along with it
+    using owner = const void*;
+    //Returns true once a waiting callback should continue
+    using condition = std::function<bool()>;
+
+    //Used by WaitForWindow, returns true once the owner's window (or all windows, for the configuration) is open and in place
+    std::function<bool(owner)> windowReady;
+
+    //Timings collected for one callback (e.g. one window's tick function), waiting time is not counted
+    struct callbackProfile
+    {
+        size_t calls = 0;
+        size_t failures = 0;
+        std::chrono::microseconds total{ 0 };
+        std::chrono::microseconds longest{ 0 };
+        //Only calls run while instructions were being counted (see ProfileInstructions) count towards these
+        size_t counted = 0;
+        //Counted in steps of instructionStep, so only approximate
+        std::uint64_t instructions = 0;
+        //Entry n counts the calls that took under 2^n milliseconds (and at least half that), the last entry counts everything longer
+        std::array<size_t, 16> histogram{};
+        //Entry n counts the counted calls that ran under 2^n thousand instructions (and at least half that), the last entry counts everything longer
+        std::array<size_t, 16> instructionHistogram{};
+    };
+
+private:
+    //How many instructions run between checks of the budget
+    static constexpr int instructionStep = 1000;
+
+    //Tracks a callback's run from when it was resumed, checked by the count hook
+    struct budget
+    {
+        clock::time_point start;
+        std::uint64_t instructions = 0;
+    };
+    static inline budget* activeBudget = nullptr;
+
+    //Stops the running callback once it goes over either budget
+    static void budgetHook(lua_State* L, lua_Debug*)
+    {
+        auto* b = activeBudget;
+        if (!b)
+            return;
+        b->instructions += instructionStep;
+        const auto& settings = appSettings::get();
+        if (settings.callbackInstructionBudget > 0 && b->instructions > static_cast<std::uint64_t>(settings.callbackInstructionBudget))
+            luaL_error(L, "stopped after running more than %d instructions without waiting", settings.callbackInstructionBudget);
+        if (settings.callbackTimeBudgetMs > 0 && clock::now() - b->start > std::chrono::milliseconds(settings.callbackTimeBudgetMs))
+            luaL_error(L, "stopped after running for more than %dms without waiting", settings.callbackTimeBudgetMs);
+    }
+
+    std::map<std::string, callbackProfile, std::less<>> profiles;
+    clock::time_point lastLogged = clock::now();
+    bool jitDisabled = false;
+
+    void record(const std::string& what, std::chrono::microseconds busy, std::optional<std::uint64_t> instructions, bool failed)
+    {
+        auto& p = profiles[what];
+        p.calls++;
+        if (failed)
+            p.failures++;
+        p.total += busy;
+        p.longest = std::max(p.longest, busy);
+        auto bucket = std::bit_width(static_cast<std::uint64_t>(busy.count() / 1000));
+        p.histogram[std::min<size_t>(bucket, p.histogram.size() - 1)]++;
+        if (instructions)
+        {
+            p.counted++;
+            p.instructions += *instructions;
+            bucket = std::bit_width(*instructions / instructionStep);
+            p.instructionHistogram[std::min<size_t>(bucket, p.instructionHistogram.size() - 1)]++;
+        }
+
+        const auto interval = appSettings::get().profileLogInterval;
+        if (interval > 0 && clock::now() - lastLogged >= std::chrono::seconds(interval))
+        {
+            lastLogged = clock::now();
+            logProfile();
+        }
+    }
+
+    struct task
+    {
+        owner who = nullptr;
+        //The callback being run, a callback that is still waiting isn't started again
+        const void* slot = nullptr;
+        std::string what;
+        //Time spent running (not waiting) so far, for the profile
+        std::chrono::microseconds busy{ 0 };
+        std::uint64_t instructions = 0;
+        //Whether every run so far had its instructions counted
+        bool counted = true;
+        //The thread must outlive the coroutine, which refers to its stack
+        sol::thread thread;
+        sol::coroutine routine;
+        //What the task is waiting for, with no condition it just waits for the deadline
+        condition ready;
+        std::optional<clock::time_point> deadline;
+    };
+    //A list so tasks stay put while others are started or finish
+    std::list<task> tasks;
+    task* running = nullptr;
+    sol::state_view lua;
+
+    static inline luaScheduler* active = nullptr;
+
+    //Runs the task until it finishes or waits, returns true if it finished and returned true
+    template <typename... Args>
+    bool resume(std::list<task>::iterator it, Args&&... args)
+    {
+        const auto& settings = appSettings::get();
+        //Instructions are counted by the same hook that enforces the budgets
+        const bool counting = settings.callbackTimeBudgetMs > 0 || settings.callbackInstructionBudget > 0 || settings.profileInstructions;
+#ifdef LUAJIT_VERSION
+        //Compiled code never calls the hook, so instructions can only be counted (and the budget enforced) while interpreting
+        //The compiler is turned back on once nothing needs counting
+        if (counting != jitDisabled)
+        {
+            luaJIT_setmode(lua.lua_state(), 0, LUAJIT_MODE_ENGINE | (counting ? LUAJIT_MODE_OFF : LUAJIT_MODE_ON));
+            jitDisabled = counting;
+        }
+#endif
+
+        bool finished = true;
+        bool failed = false;
+        bool returnedTrue = false;
+        {
+            traceSpan span("lua callback", it->what);
+            budget slice{ clock::now() };
+            auto previousBudget = std::exchange(activeBudget, &slice);
+            //LuaJIT shares one hook between every thread of the state, so it is removed again afterwards rather than left running during reloads
+            if (counting)
+                lua_sethook(it->thread.thread_state(), &budgetHook, LUA_MASKCOUNT, instructionStep);
+            auto previous = std::exchange(running, &*it);
+            auto result = it->routine(std::forward<Args>(args)...);
+            running = previous;
+            activeBudget = previousBudget;
+            //A callback run from inside another (e.g. through StateHasChanged) leaves the hook to the outer one
+            if (counting && !previousBudget)
+                lua_sethook(it->thread.thread_state(), nullptr, 0, 0);
+            it->busy += std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - slice.start);
+            it->instructions += slice.instructions;
+            it->counted = it->counted && counting;
+
+            if (!result.valid())
+            {
+                failed = true;
+                sol::error error = result;
+                std::cout << osm::feat(osm::col, "orange") << "Failed to run " << it->what << ": " << error.what() << ".\n" << osm::feat(osm::rst, "all");
+            }
+            else if (it->routine.status() == sol::call_status::yielded)
+            {
+                finished = false;
+                //A plain coroutine.yield() has nothing to wait for, so it carries on with the next pass
+                if (!it->ready && !it->deadline)
+                    it->deadline = clock::now();
+            }
+            else
+            {
+                returnedTrue = result.return_count() > 0 && result.get_type() == sol::type::boolean && result.template get<bool>();
+            }
+        }
+        //The result refers to the task's stack, so it has to be gone before the task is
+        if (finished)
+        {
+            record(it->what, it->busy, it->counted ? std::optional(it->instructions) : std::nullopt, failed);
+            tasks.erase(it);
+        }
+        return returnedTrue;
+    }
+
+public:
+    explicit luaScheduler(sol::state_view state) : lua(state)
+    {
+        active = this;
+    }
+    luaScheduler(const luaScheduler&) = delete;
+    luaScheduler& operator=(const luaScheduler&) = delete;
+    ~luaScheduler()
+    {
+        tasks.clear();
+        if (active == this)
+            active = nullptr;
+    }
+
+    //The scheduler for the current lua state, or nullptr if there isn't one (e.g. while shutting down)
+    static luaScheduler* current()
+    {
+        return active;
+    }
+
+    static luaScheduler& get()
+    {
+        if (!active)
+            throw std::runtime_error("No lua scheduler is running.");
+        return *active;
+    }
+
+    //Returns true if the given callback of the owner is still waiting from an earlier run
+    bool isWaiting(owner who, const void* slot) const
+    {
+        return std::any_of(tasks.begin(), tasks.end(), [&](const task& t) { return t.who == who && t.slot == slot; });
+    }
+
+    //Starts the callback as a coroutine, the description is used in error messages
+    //Returns true if it finished without waiting and returned true
+    template <typename... Args>
+    bool run(owner who, const void* slot, std::string_view what, const sol::protected_function& function, Args&&... args)
+    {
+        if (!function.valid() || isWaiting(who, slot))
+            return false;
+
+        auto& t = tasks.emplace_back();
+        t.who = who;
+        t.slot = slot;
+        t.what = what;
+        t.thread = sol::thread::create(lua.lua_state());
+        lua_State* threadState = t.thread.thread_state();
+        function.push(threadState);
+        t.routine = sol::coroutine(threadState, -1);
+        lua_pop(threadState, 1);
+        return resume(std::prev(tasks.end()), std::forward<Args>(args)...);
+    }
+
+    //Drops every callback of the owner that is still waiting, for when the owner goes away
+    void cancel(owner who)
+    {
+        tasks.remove_if([&](const task& t) { return t.who == who && &t != running; });
+    }
+
+    //Resumes every callback whose wait is over, waits with a condition are told whether it was met (rather than timing out)
+    void resumeReady()
+    {
+        const auto now = clock::now();
+        for (auto it = tasks.begin(); it != tasks.end();)
+        {
+            //Resuming may finish the task, or start new ones at the end of the list
+            auto next = std::next(it);
+            if (&*it != running)
+            {
+                const bool met = it->ready && it->ready();
+                const bool timedOut = it->deadline && *it->deadline <= now;
+                if (met || timedOut)
+                {
+                    const bool hadCondition = static_cast<bool>(it->ready);
+                    it->ready = {};
+                    it->deadline.reset();
+                    if (hadCondition)
+                        resume(it, met);
+                    else
+                        resume(it);
+                }
+            }
+            it = next;
+        }
+    }
+
+    //The earliest time a waiting callback may need resuming, conditions without a timeout are checked after every event instead
+    std::optional<clock::time_point> nextDue() const
+    {
+        std::optional<clock::time_point> result;
+        for (const auto& t : tasks)
+        {
+            if (t.deadline && (!result || *t.deadline < *result))
+                result = t.deadline;
+        }
+        return result;
+    }
+
+    const std::map<std::string, callbackProfile, std::less<>>& getProfiles() const
+    {
+        return profiles;
+    }
+
+    void resetProfiles()
+    {
+        profiles.clear();
+    }
+
+    //Prints the timings of every callback, slowest (on average) first
+    void logProfile() const
+    {
+        std::vector<std::pair<const std::string*, const callbackProfile*>> ordered;
+        for (const auto& [name, p] : profiles)
+            ordered.emplace_back(&name, &p);
+        auto average = [](const callbackProfile& p) -> std::chrono::microseconds { return std::chrono::microseconds(p.calls ? p.total.count() / static_cast<long long>(p.calls) : 0); };
+        std::sort(ordered.begin(), ordered.end(), [&](const auto& a, const auto& b) { return average(*a.second) > average(*b.second); });
+
+        std::cout << "Callback timings:\n";
+        for (const auto& [name, p] : ordered)
+        {
+            std::cout << "  " << *name << ": " << p->calls << " calls";
+            if (p->failures)
+                std::cout << " (" << p->failures << " failed)";
+            std::cout << ", average " << average(*p).count() / 1000.0 << "ms, longest " << p->longest.count() / 1000.0 << "ms";
+            if (p->counted)
+                std::cout << ", about " << p->instructions / p->counted << " instructions per call";
+            std::cout << "\n";
+        }
+    }
+
+    //The profile as a lua table, keyed by callback
+    sol::table profileTable(sol::this_state L) const
+    {
+        sol::state_view state(L);
+        auto result = state.create_table();
+        for (const auto& [name, p] : profiles)
+        {
+            auto entry = state.create_table();
+            entry["Calls"] = p.calls;
+            entry["Failures"] = p.failures;
+            entry["TotalMs"] = p.total.count() / 1000.0;
+            entry["LongestMs"] = p.longest.count() / 1000.0;
+            entry["Instructions"] = p.instructions;
+            auto histogram = state.create_table();
+            for (size_t i = 0; i < p.histogram.size(); ++i)
+                histogram[i + 1] = p.histogram[i];
+            entry["Histogram"] = histogram;
+            auto instructionHistogram = state.create_table();
+            for (size_t i = 0; i < p.instructionHistogram.size(); ++i)
+                instructionHistogram[i + 1] = p.instructionHistogram[i];
+            entry["InstructionHistogram"] = instructionHistogram;
+            result[name] = entry;
+        }
+        return result;
+    }
+
+    //The owner of the callback running on the given lua thread, if it is one of ours
+    static std::optional<owner> runningOwner(lua_State* L)
+    {
+        if (!active || !active->running || active->running->thread.thread_state() != L)
+            return std::nullopt;
+        return active->running->who;
+    }
+
+    //For use by lua functions: suspends the running callback until the condition is met or the timeout passes
+    //Returns what the lua function should return, or raises a lua error if the caller isn't one of our callbacks
+    static int wait(lua_State* L, condition ready, std::optional<std::chrono::milliseconds> timeout)
+    {
+        if (!runningOwner(L))
+            return luaL_error(L, "Waiting is only possible inside OnTick, OnOpen or OnUpdate functions");
+        auto& t = *active->running;
+        t.ready = std::move(ready);
+        if (timeout)
+            t.deadline = clock::now() + *timeout;
+        return lua_yield(L, 0);
+    }
+};
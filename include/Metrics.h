@@ -0,0 +1,237 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Counters and histograms describing what the kiosk has been doing, rendered in the Prometheus text format
+//Only the main thread records or renders metrics, so nothing here is locked
+class metricRegistry
+{
+    struct counter
+    {
+        std::string help;
+        //Keyed by the rendered label set, e.g. reason="exited"
+        std::map<std::string, double, std::less<>> values;
+    };
+
+    struct histogram
+    {
+        std::string help;
+        std::vector<double> bounds;
+        struct series
+        {
+            //Not cumulative, they are summed up when rendered
+            std::vector<std::uint64_t> buckets;
+            double sum = 0;
+            std::uint64_t count = 0;
+        };
+        std::map<std::string, series, std::less<>> values;
+    };
+
+    std::map<std::string, counter, std::less<>> counters;
+    std::map<std::string, histogram, std::less<>> histograms;
+
+    metricRegistry() = default;
+
+    static std::string withLabels(std::string_view name, std::string_view labels, std::string_view extra = {})
+    {
+        std::string result(name);
+        if (labels.empty() && extra.empty())
+            return result;
+        result += '{';
+        result += labels;
+        if (!labels.empty() && !extra.empty())
+            result += ',';
+        result += extra;
+        result += '}';
+        return result;
+    }
+
+    static std::string number(double value)
+    {
+        //The shortest text that reads back as the same value
+        char buffer[32];
+        auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        return error == std::errc() ? std::string(buffer, end) : "NaN";
+    }
+
+public:
+    //Bucket bounds for durations in seconds, from a millisecond to ten seconds
+    static inline const std::vector<double> durationBounds = { 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 };
+    //Bucket bounds for small counts, such as requests made in a tick
+    static inline const std::vector<double> countBounds = { 0, 1, 2, 5, 10, 20, 50, 100, 200, 500 };
+
+    metricRegistry(const metricRegistry&) = delete;
+    metricRegistry& operator=(const metricRegistry&) = delete;
+
+    static metricRegistry& get()
+    {
+        static metricRegistry registry;
+        return registry;
+    }
+
+    //Adds to a counter, creating it on first use, labels are written as they appear in the output (e.g. reason="exited")
+    void count(std::string_view name, std::string_view help, std::string_view labels = {}, double amount = 1)
+    {
+        auto it = counters.find(name);
+        if (it == counters.end())
+            it = counters.emplace(std::string(name), counter{ std::string(help), {} }).first;
+        auto value = it->second.values.find(labels);
+        if (value == it->second.values.end())
+            value = it->second.values.emplace(std::string(labels), 0.0).first;
+        value->second += amount;
+    }
+
+    //Records a value in a histogram, creating it with the given bounds on first use
+    void observe(std::string_view name, std::string_view help, double value, std::string_view labels = {}, const std::vector<double>& bounds = durationBounds)
+    {
+        auto it = histograms.find(name);
+        if (it == histograms.end())
+            it = histograms.emplace(std::string(name), histogram{ std::string(help), bounds, {} }).first;
+        auto& h = it->second;
+        auto s = h.values.find(labels);
+        if (s == h.values.end())
+            s = h.values.emplace(std::string(labels), histogram::series{ std::vector<std::uint64_t>(h.bounds.size() + 1, 0), 0, 0 }).first;
+        const auto bucket = std::lower_bound(h.bounds.begin(), h.bounds.end(), value) - h.bounds.begin();
+        s->second.buckets[static_cast<size_t>(bucket)]++;
+        s->second.sum += value;
+        s->second.count++;
+    }
+
+    //Everything recorded so far, in the Prometheus text exposition format
+    std::string render() const
+    {
+        std::string out;
+        for (const auto& [name, c] : counters)
+        {
+            out += "# HELP " + name + " " + c.help + "\n# TYPE " + name + " counter\n";
+            for (const auto& [labels, value] : c.values)
+                out += withLabels(name, labels) + " " + number(value) + "\n";
+        }
+        for (const auto& [name, h] : histograms)
+        {
+            out += "# HELP " + name + " " + h.help + "\n# TYPE " + name + " histogram\n";
+            for (const auto& [labels, s] : h.values)
+            {
+                std::uint64_t cumulative = 0;
+                for (size_t b = 0; b < s.buckets.size(); ++b)
+                {
+                    cumulative += s.buckets[b];
+                    const auto bound = b < h.bounds.size() ? number(h.bounds[b]) : "+Inf";
+                    out += withLabels(name + "_bucket", labels, "le=\"" + bound + "\"") + " " + std::to_string(cumulative) + "\n";
+                }
+                out += withLabels(name + "_sum", labels) + " " + number(s.sum) + "\n";
+                out += withLabels(name + "_count", labels) + " " + std::to_string(s.count) + "\n";
+            }
+        }
+        return out;
+    }
+};
+
+//Records how long it lived in a duration histogram
+class metricTimer
+{
+    std::string_view name;
+    std::string_view help;
+    std::string_view labels;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+public:
+    //The strings must outlive the timer, they are expected to be literals
+    metricTimer(std::string_view name, std::string_view help, std::string_view labels = {}) : name(name), help(help), labels(labels) {}
+    metricTimer(const metricTimer&) = delete;
+    metricTimer& operator=(const metricTimer&) = delete;
+    ~metricTimer()
+    {
+        metricRegistry::get().observe(name, help, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), labels);
+    }
+};
+
+//The kiosk's own metrics, so each is named and described in one place
+//Labels are given as literals, e.g. phase="lua"
+inline metricTimer timeTick()
+{
+    return metricTimer("kiosk_tick_seconds", "Time taken by each tick of the windows that were due.");
+}
+inline metricTimer timeTickPhase(std::string_view labels)
+{
+    return metricTimer("kiosk_tick_phase_seconds", "Time taken by each part of a tick: checking the monitors, supervising windows, lua callbacks and file watches.", labels);
+}
+inline metricTimer timeReload()
+{
+    return metricTimer("kiosk_reload_seconds", "Time taken to compile and apply a configuration.");
+}
+inline void countLaunch()
+{
+    metricRegistry::get().count("kiosk_launches_total", "Browser processes started.");
+}
+inline void countFailedRegistration()
+{
+    metricRegistry::get().count("kiosk_failed_registrations_total", "Started browsers whose window could not be found.");
+}
+inline void countRestart(std::string_view labels)
+{
+    metricRegistry::get().count("kiosk_restarts_total", "Windows restarted, by why they were restarted.", labels);
+}
+inline void countTickRequests(std::uint64_t requests)
+{
+    metricRegistry::get().observe("kiosk_x_requests_per_tick", "Requests sent to the X server by each tick.", static_cast<double>(requests), {}, metricRegistry::countBounds);
+}
+inline void countCloseAll()
+{
+    metricRegistry::get().count("kiosk_close_all_total", "Times every instance of the browser was closed.");
+}
+
+//Platform specific
+//How many requests have been sent to the window system so far, or zero where they can't be counted
+std::uint64_t windowSystemRequests();
+
+//Serves the metrics over HTTP, on a Unix socket (MetricsSocket) and/or a localhost port (MetricsPort)
+//Every listening socket and open connection is grouped into one descriptor that can be waited on, like the DevTools pipes
+class metricsServer
+{
+    struct connection
+    {
+        int fd = -1;
+        std::string request;
+        std::string response;
+        std::chrono::steady_clock::time_point opened;
+    };
+
+    int source = -1;
+    std::vector<int> listeners;
+    std::vector<connection> connections;
+    //What the listeners were opened for, so they are only reopened if the settings change
+    std::string openSocket;
+    int openPort = 0;
+    //The socket file we created, removed when we stop listening
+    std::string socketFile;
+
+    metricsServer() = default;
+    ~metricsServer();
+
+    void closeAll();
+    void accept(int listener);
+    //Returns false once the connection is finished with
+    bool serve(connection& c);
+
+public:
+    metricsServer(const metricsServer&) = delete;
+    metricsServer& operator=(const metricsServer&) = delete;
+
+    static metricsServer& get();
+
+    //Starts (or stops) listening as the settings ask, does nothing if they haven't changed
+    void configure(const std::string& socketPath, int port);
+
+    //Returns a file descriptor that becomes readable when there is something to do, or -1 if nothing is listening
+    int eventSource() const { return source; }
+
+    //Accepts new connections and answers any that have sent their request
+    void update();
+};
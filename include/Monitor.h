@@ -2,4 +2,15 @@
 #include <vector>
 #include "Rect.h"
 
-std::vector<rect> getMonitors();
\ No newline at end of file
+//Returns the monitor spaces, ordered left to right, top to bottom
+//The layout is cached until it is reported to have changed, so this is cheap to call repeatedly
+const std::vector<rect>& getMonitors();
+
+//Incremented every time the monitor layout is seen to change
+size_t getMonitorGeneration();
+
+//Forgets the cached layout, so the next call to getMonitors queries it again
+void invalidateMonitors();
+
+//The index the window system itself uses for the given monitor, which may not follow our left to right order
+int getSystemMonitorIndex(int monitor);
@@ -0,0 +1,26 @@
+#pragma once
+#include <string_view>
+
+//Judges whether a browser window's page has loaded from the window's title alone, for windows without DevTools
+//Browsers title their window after the page followed by their own name (e.g. "Dashboard - Chromium"), and after the url (or a blank tab) while loading
+//So the page counts as loaded once the title, without the browser's name, is neither empty, a blank tab, nor the start of the url
+//It can't tell a page still loading from one whose own title looks like its url (or that never sets a title), those wait for ReadyTimeout,
+//and a page that redirects elsewhere may count as loaded while the new url is still loading
+inline bool titleShowsLoaded(std::string_view title, std::string_view url)
+{
+    //The browser's name goes after the last separator
+    if (auto separator = title.rfind(" - "); separator != std::string_view::npos)
+        title = title.substr(0, separator);
+    if (title.empty() || title == "New Tab" || title == "about:blank")
+        return false;
+    //A plain word that happens to be part of the url (e.g. "dashboard") is the page's own title, a url has a host or path
+    if (title.find_first_of("./:") == std::string_view::npos)
+        return true;
+    while (!title.empty() && title.back() == '/')
+        title.remove_suffix(1);
+    //Browsers usually leave off the scheme
+    auto bare = url;
+    if (auto scheme = bare.find("://"); scheme != std::string_view::npos)
+        bare.remove_prefix(scheme + 3);
+    return !url.starts_with(title) && !bare.starts_with(title);
+}
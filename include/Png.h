@@ -0,0 +1,73 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include <zlib.h>
+#include "FrameSample.h"
+
+//Appends a PNG chunk: its length, type, data and the CRC of the type and data
+inline void appendPngChunk(std::vector<std::uint8_t>& out, std::string_view type, const std::uint8_t* data, size_t size)
+{
+    auto appendWord = [&](std::uint32_t value)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            out.push_back(static_cast<std::uint8_t>(value >> shift));
+    };
+    appendWord(static_cast<std::uint32_t>(size));
+    const size_t start = out.size();
+    out.insert(out.end(), type.begin(), type.end());
+    out.insert(out.end(), data, data + size);
+    appendWord(static_cast<std::uint32_t>(crc32(0, out.data() + start, static_cast<uInt>(out.size() - start))));
+}
+
+//Encodes the frame as an 8 bit RGB PNG at the given zlib level (0-9), or nothing if it couldn't be compressed
+//Rows use the Sub filter, which suits screen content well for the little it costs
+inline std::optional<std::vector<std::uint8_t>> encodePng(const capturedFrame& frame, int level)
+{
+    if (frame.width <= 0 || frame.height <= 0)
+        return std::nullopt;
+    const size_t width = static_cast<size_t>(frame.width);
+    const size_t rowBytes = 1 + width * 3;
+    std::vector<std::uint8_t> filtered(rowBytes * static_cast<size_t>(frame.height));
+    for (size_t y = 0; y < static_cast<size_t>(frame.height); ++y)
+    {
+        const std::uint8_t* source = frame.pixels.data() + y * width * 4;
+        std::uint8_t* row = filtered.data() + y * rowBytes;
+        //Filter type 1 (Sub), each byte is stored as the difference from the same channel of the pixel before
+        row[0] = 1;
+        std::uint8_t previous[3] = { 0, 0, 0 };
+        for (size_t x = 0; x < width; ++x)
+        {
+            //BGRX to RGB
+            const std::uint8_t rgb[3] = { source[x * 4 + 2], source[x * 4 + 1], source[x * 4] };
+            for (int c = 0; c < 3; ++c)
+            {
+                row[1 + x * 3 + c] = static_cast<std::uint8_t>(rgb[c] - previous[c]);
+                previous[c] = rgb[c];
+            }
+        }
+    }
+
+    uLongf compressedSize = compressBound(static_cast<uLong>(filtered.size()));
+    std::vector<std::uint8_t> compressed(compressedSize);
+    if (compress2(compressed.data(), &compressedSize, filtered.data(), static_cast<uLong>(filtered.size()), std::clamp(level, 0, 9)) != Z_OK)
+        return std::nullopt;
+
+    std::vector<std::uint8_t> out = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    std::array<std::uint8_t, 13> header{};
+    for (int i = 0; i < 4; ++i)
+    {
+        header[i] = static_cast<std::uint8_t>(static_cast<std::uint32_t>(frame.width) >> (24 - i * 8));
+        header[4 + i] = static_cast<std::uint8_t>(static_cast<std::uint32_t>(frame.height) >> (24 - i * 8));
+    }
+    //8 bits per channel, RGB, deflate, adaptive filtering, no interlacing
+    header[8] = 8;
+    header[9] = 2;
+    appendPngChunk(out, "IHDR", header.data(), header.size());
+    appendPngChunk(out, "IDAT", compressed.data(), compressedSize);
+    appendPngChunk(out, "IEND", nullptr, 0);
+    return out;
+}
@@ -7,6 +7,18 @@
 #include "Rect.h"
 #include "Settings.h"
 #include "Monitor.h"
+#include "WindowEvents.h"
+#include "WindowQuery.h"
+#include "LuaScheduler.h"
+#include "Reconcile.h"
+#include "DevTools.h"
+#include "HiddenWindow.h"
+#include "PageReadiness.h"
+#include "InputQueue.h"
+#include "FrameSample.h"
+#include "Screenshot.h"
+#include "Metrics.h"
+#include "Trace.h"
 
 class process
 {
@@ -14,14 +26,55 @@ class process
     size_t tickCount = 0;
     sol::protected_function onTick;
     sol::protected_function onOpen;
+    sol::protected_function onUnhealthy;
     processId pId = 0;
     windowHandle wHandle = 0;
     std::string url;
+    //The configuration's Id for this window, empty if it wasn't given one
+    std::string id;
     bool cacheBuster = false;
     int nudges = 0;
+    //How often this window ticks, zero uses the global refresh time
+    std::chrono::milliseconds interval{ 0 };
+
+    //Progress of moving the window onto its monitor, where placement is confirmed by the window system rather than waited for
+    enum class placementStep { idle, leavingFullscreen, moving, enteringFullscreen };
+    placementStep placing = placementStep::idle;
+    //How many times the current step has been sent without being confirmed
+    int placementAttempts = 0;
+    //When we stop waiting for the current step and send it again
+    std::chrono::steady_clock::time_point placementDeadline;
+    //Whether the window was on its monitor when last checked
+    bool placed = false;
+
+    //Whether the window was opened but its page hasn't been seen to load yet, OnOpen runs once it has
+    bool awaitingReady = false;
+    //When we stop waiting for the page and run OnOpen anyway
+    std::chrono::steady_clock::time_point readyDeadline;
+
+    //Pages shown in turn (if there is more than one), and which is showing
+    std::vector<playlistEntry> playlist;
+    size_t playlistIndex = 0;
+    //When the page showing has been shown for long enough
+    std::chrono::steady_clock::time_point nextRotation;
+    //The next page, loading out of sight
+    hiddenWindow nextPage;
+    //The page that was replaced, kept showing underneath until the new one is in place
+    hiddenWindow retiring;
+    //Set if the next page can't be loaded out of sight, in which case the window changes page itself
+    bool rotateInPlace = false;
+
+    //What the health check has seen of the window's page
+    frameHealth health;
 
     bool valid() const;
 
+    //The DevTools channel to this window's browser, if it has one
+    devToolsChannel* channel() const
+    {
+        return pId != 0 ? devTools::get().find(pId) : nullptr;
+    }
+
     auto getCacheBuster() const
     {
         if (watches.empty())
@@ -32,64 +85,161 @@ class process
     //Attempts to start the process and assign window handle
     void start(std::span<const windowHandle> existing, const windowHandle self) 
     {
+        traceSpan span("start window", describe());
         if (valid())
             close();
 
-        //Add the cache buster if required
+        adopt(startProcess(getLaunchUrl(), existing, self));
+    }
+
+public:
+    //The url to open, including the cache buster if required
+    std::string getLaunchUrl() const
+    {
         auto toOpen = url;
         if (cacheBuster)
         {
             toOpen += (url.find('?') == std::string::npos ? "?" : "&") + std::to_string(getCacheBuster());
         }
+        return toOpen;
+    }
 
-        auto process = startProcess(toOpen, existing, self);
-        if (process)
-		{
-			pId = process->first;
-			wHandle = process->second;
-            if (onOpen.valid())
-			{
-				auto result = onOpen(std::ref(*this));
-                if (!result.valid())
-                {
-                    sol::error error = result;
-                    std::cout << osm::feat(osm::col, "orange") << "Failed to run OnOpen function: " << error.what() << ".\n" << osm::feat(osm::rst, "all");
-                }
-			}
-		}
+    //Names the window in messages, callbacks are told apart by the window's monitor
+    std::string describe() const
+    {
+        return "monitor " + std::to_string(monitor);
     }
 
-    bool isInPosition(rect area) const;
+    //Takes ownership of a newly started process, if there is one
+    //If the launch failed, the old window (which is gone or closed by now) is forgotten, so nothing mistakes it for a live one
+    void adopt(std::optional<std::pair<processId, windowHandle>> process)
+    {
+        if (!process)
+        {
+            detach();
+            return;
+        }
+        pId = process->first;
+        wHandle = process->second;
+        placing = placementStep::idle;
+        placed = false;
+        awaitingReady = true;
+        health.reset();
+        readyDeadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(appSettings::get().readyTimeout));
+        //Title changes wake us up to check the page, even if windows aren't otherwise watched
+        watchWindow(wHandle);
+    }
 
-    //Checks if the window is on the correct monitor
-    bool checkMonitor() const 
+    //Runs OnOpen once the newly opened page has loaded, or once ReadyTimeout has passed
+    //The page has loaded once DevTools reports its load event, or without DevTools, once the window is shown with the page's own title (see titleShowsLoaded)
+    void checkReady(const windowState& state, std::chrono::steady_clock::time_point now)
     {
-        if (monitor == -1) return true;
-        auto monitors = getMonitors();
-        if (monitor >= static_cast<int>(monitors.size())) return true;
-        if (!isInPosition(monitors[monitor])) 
+        if (!awaitingReady)
+            return;
+        if (!state.exists)
         {
-            moveToMonitor(monitors[monitor]);
+            //A window that is gone has no page to wait for, stop once the deadline passes so it isn't due forever
+            //Its replacement waits for its own page when it is adopted
+            if (now >= readyDeadline)
+                awaitingReady = false;
+            return;
+        }
+        bool ready = false;
+        if (auto c = channel())
+            ready = c->isLoaded();
+        else
+            ready = state.mapped && titleShowsLoaded(state.title, getLaunchUrl());
+
+        if (!ready && now < readyDeadline)
+            return;
+        if (!ready)
+            std::cout << osm::feat(osm::col, "orange") << "The page on " << describe() << " did not finish loading within ReadyTimeout, running OnOpen anyway.\n" << osm::feat(osm::rst, "all");
+        awaitingReady = false;
+        luaScheduler::get().run(this, &onOpen, "OnOpen function for " + describe(), onOpen, std::ref(*this));
+    }
+
+    //Whether the window is settled enough for the health check to sample it
+    bool isSampleable() const { return wHandle != 0 && placed && !awaitingReady && !isPlacing(); }
+
+    //Records a health check sample of the window, returns true if the window should be restarted
+    //A window that has been blank or frozen for long enough runs OnUnhealthy, which restarts it by returning true, otherwise HealthCheck's Restart decides
+    bool checkHealth(const frameSample& sample)
+    {
+        auto problem = health.record(sample);
+        if (!problem)
             return false;
+        std::cout << osm::feat(osm::col, "orange") << "The page on " << describe() << " looks " << *problem << ".\n" << osm::feat(osm::rst, "all");
+        if (onUnhealthy.valid())
+            return luaScheduler::get().run(this, &onUnhealthy, "OnUnhealthy function for " + describe(), onUnhealthy, std::ref(*this), std::string(*problem));
+        return appSettings::get().healthRestart;
+    }
+
+    //When the placement step being waited on should be checked (and sent again if it wasn't confirmed), if the window is being placed
+    std::optional<std::chrono::steady_clock::time_point> placementDue() const
+    {
+        if (!isPlacing() || wHandle == 0)
+            return std::nullopt;
+        return placementDeadline;
+    }
+
+    //Whether OnOpen is waiting for the page to load, and if so until when
+    std::optional<std::chrono::steady_clock::time_point> readyBy() const
+    {
+        if (!awaitingReady || wHandle == 0)
+            return std::nullopt;
+        return readyDeadline;
+    }
+
+private:
+
+    bool isInPosition(rect area) const;
+    //Checks an already queried window state, avoiding another query
+    static bool isInPosition(const windowState& state, rect area);
+
+    //Checks if the window is on the correct monitor, using the known state if there is one
+    bool checkMonitor(const windowState* known = nullptr)
+    {
+        //Windows without a monitor of their own are wherever they are meant to be
+        placed = true;
+        const auto& monitors = getMonitors();
+        if (monitor == -1 || monitor >= static_cast<int>(monitors.size()))
+        {
+            placing = placementStep::idle;
+            return true;
         }
-        return true;
+        bool inPosition = known ? isInPosition(*known, monitors[monitor]) : isInPosition(monitors[monitor]);
+        placed = inPosition;
+        if (inPosition)
+        {
+            placing = placementStep::idle;
+            return true;
+        }
+        traceSpan span("move to monitor", describe());
+        if (moveToMonitor(monitor, monitors[monitor], known))
+        {
+            //Reset the nudge count if we had to use the keyboard to fullscreen the window
+            nudges = appSettings::get().nudges;
+        }
+        return false;
     }
 
-    void moveToMonitor(rect monitorRect) const;
+    //Moves the window towards the given monitor and fullscreens it, the monitor index is our (left to right) index
+    //Returns true if keystrokes were sent to the window to do so
+    bool moveToMonitor(int monitorIndex, rect monitorRect, const windowState* known);
 
     void close() const;
 
+    //Every key is pressed in one batch, so the window is only focused once
     void luaPress(sol::variadic_args keys, bool shift, bool control, bool alt)
     {
+        inputBatch batch(pId, wHandle);
         for (auto v : keys)
         {
             std::string k = v.get<std::string>();
             std::transform(k.begin(), k.end(), k.begin(), [](unsigned char c) { return std::toupper(c); });
-            if (auto code = getKeycode(k))
-            {
-                sendMessage(code, shift, control, alt);
-            }
+            batch.press(getKeycode(k), shift, control, alt);
         }
+        inputQueue::get().submit(std::move(batch));
     }
 
 public:
@@ -102,105 +252,302 @@ public:
 		tickCount = other.tickCount;
 		onTick = std::move(other.onTick);
 		onOpen = std::move(other.onOpen);
+		onUnhealthy = std::move(other.onUnhealthy);
 		pId = std::exchange(other.pId, {});
 		wHandle = std::exchange(other.wHandle, {});
 		url = std::move(other.url);
+        id = std::move(other.id);
         monitor = other.monitor;
         cacheBuster = other.cacheBuster;
+        interval = other.interval;
+        placing = other.placing;
+        placementAttempts = other.placementAttempts;
+        placementDeadline = other.placementDeadline;
+        placed = other.placed;
+        awaitingReady = other.awaitingReady;
+        readyDeadline = other.readyDeadline;
+        playlist = std::move(other.playlist);
+        playlistIndex = other.playlistIndex;
+        nextRotation = other.nextRotation;
+        nextPage = std::move(other.nextPage);
+        retiring = std::move(other.retiring);
+        rotateInPlace = other.rotateInPlace;
+        health = other.health;
     }
 
     process& operator=(const process&) = delete;
         process& operator=(process&& other) noexcept
     {
+        //Waiting callbacks refer to this window, which is about to become a different one
+        if (auto scheduler = luaScheduler::current())
+            scheduler->cancel(this);
         watches = std::move(other.watches);
         tickCount = other.tickCount;
         onTick = std::move(other.onTick);
         onOpen = std::move(other.onOpen);
+        onUnhealthy = std::move(other.onUnhealthy);
         pId = std::exchange(other.pId, {});
         wHandle = std::exchange(other.wHandle, {});
         url = std::move(other.url);
+        id = std::move(other.id);
         monitor = other.monitor;
         cacheBuster = other.cacheBuster;
+        interval = other.interval;
+        placing = other.placing;
+        placementAttempts = other.placementAttempts;
+        placementDeadline = other.placementDeadline;
+        placed = other.placed;
+        awaitingReady = other.awaitingReady;
+        readyDeadline = other.readyDeadline;
+        playlist = std::move(other.playlist);
+        playlistIndex = other.playlistIndex;
+        nextRotation = other.nextRotation;
+        nextPage = std::move(other.nextPage);
+        retiring = std::move(other.retiring);
+        rotateInPlace = other.rotateInPlace;
+        health = other.health;
         return *this;
     }
     ~process() 
     {
+        //Waiting callbacks hold a reference to this window, so they can't outlive it
+        if (auto scheduler = luaScheduler::current())
+            scheduler->cancel(this);
         close();
     }
 
     void setTick(size_t value) { tickCount = value; }
+    std::chrono::milliseconds getInterval() const
+    {
+        if (interval.count() > 0)
+            return interval;
+        return std::chrono::seconds(appSettings::get().refreshTime);
+    }
+    processId getProcessId() const { return pId; }
+    //Forgets the process and window, for when they are known to have gone
+    void detach()
+    {
+        inputQueue::get().cancel(wHandle);
+        pId = 0;
+        wHandle = 0;
+        placing = placementStep::idle;
+        placed = false;
+        awaitingReady = false;
+        health.reset();
+    }
+    //Closes the window so the next check opens it again
+    void restart()
+    {
+        close();
+        detach();
+    }
+    //Changes the page shown, in place if the browser has a DevTools channel, otherwise by reopening the window
+    //Returns true if the window was kept
+    bool navigate(std::string newUrl)
+    {
+        url = std::move(newUrl);
+        if (auto c = channel(); c && c->isAttached() && wHandle != 0)
+        {
+            health.reset();
+            c->navigate(getLaunchUrl());
+            return true;
+        }
+        restart();
+        return false;
+    }
+    //Reloads the page, through DevTools where possible so a cache buster can be brought up to date
+    void refresh() const
+    {
+        if (auto c = channel(); c && c->isAttached())
+        {
+            if (cacheBuster)
+                c->navigate(getLaunchUrl());
+            else
+                c->reload();
+            return;
+        }
+        static const auto refreshKey = getKeycode("F5");
+        sendMessage(refreshKey);
+    }
+    //Whether the window is part way through being placed, and so still needs checking
+    bool isPlacing() const { return placing != placementStep::idle; }
+    //Whether the window is open and was on its monitor when last checked
+    bool isPlaced() const { return wHandle != 0 && placed; }
     std::string_view getUrl() const { return url; }
+    //A playlist is known by its first page, whichever page it is showing
+    windowIdentity identity() const { return { id, playlist.empty() ? url : playlist.front().url, monitor }; }
+
+    bool hasPlaylist() const { return playlist.size() > 1; }
+    windowHandle nextPageHandle() const { return nextPage.getHandle(); }
+
+    //When the playlist next needs moving on, if the window has one
+    std::optional<std::chrono::steady_clock::time_point> rotationDue() const
+    {
+        if (!hasPlaylist() || wHandle == 0)
+            return std::nullopt;
+        //Once due, we wait as long as ReadyTimeout for the next page to load
+        if (std::chrono::steady_clock::now() >= nextRotation)
+            return nextRotation + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(appSettings::get().readyTimeout));
+        return nextRotation;
+    }
+
+    //Moves the playlist on once the page showing has had its time, swapping in the next page once it has loaded out of sight
+    //The next page's state must have been queried for its handle, returns true if it was swapped in and so needs placing
+    bool rotate(std::span<const windowHandle> known, const windowState& nextState, std::chrono::steady_clock::time_point now)
+    {
+        if (!hasPlaylist() || wHandle == 0)
+            return false;
+        const auto& following = playlist[(playlistIndex + 1) % playlist.size()];
+
+        //Once the new page covers the monitor, the old one can go (or be reused for the page after)
+        if (!retiring.empty() && isPlaced())
+        {
+            if (nextPage.empty() && retiring.recycle(following.url))
+                nextPage = std::move(retiring);
+            else
+                retiring.close();
+        }
+
+        if (!rotateInPlace && nextPage.empty() && retiring.empty())
+            rotateInPlace = !nextPage.start(following.url);
+        if (!nextPage.update(known, now))
+            std::cout << osm::feat(osm::col, "orange") << "The next page for " << describe() << " didn't open in time, trying again.\n" << osm::feat(osm::rst, "all");
+
+        if (now < nextRotation)
+            return false;
+        const bool ready = nextPage.isReady(nextState);
+        const bool overdue = now >= *rotationDue();
+        if (!ready && !overdue)
+            return false;
+
+        playlistIndex = (playlistIndex + 1) % playlist.size();
+        nextRotation = now + playlist[playlistIndex].dwell;
+        if (rotateInPlace || nextPage.getHandle() == 0)
+        {
+            //Nothing was loaded out of sight, so change page the old way
+            nextPage.close();
+            navigate(playlist[playlistIndex].url);
+            return false;
+        }
+        if (!ready)
+            std::cout << osm::feat(osm::col, "orange") << "The next page for " << describe() << " did not finish loading within ReadyTimeout, showing it anyway.\n" << osm::feat(osm::rst, "all");
+
+        //The new page goes over the old, which stays until the new one is in place so the monitor never goes blank
+        retiring.hold(pId, wHandle, url);
+        std::tie(pId, wHandle) = nextPage.release();
+        health.reset();
+        url = playlist[playlistIndex].url;
+        placing = placementStep::idle;
+        placed = false;
+        restoreWindow(wHandle);
+        watchWindow(wHandle);
+        return true;
+    }
     windowHandle getHandle() const { return wHandle; }
 
-    void sendMessage(keycode vkCode, bool shiftPress = false, bool controlPress = false, bool altPress = false) const;
-    void sendClick(int x, int y, sol::optional<int> buttonType) const;
+    void sendMessage(keycode vkCode, bool shiftPress = false, bool controlPress = false, bool altPress = false) const
+    {
+        traceSpan span("send message", describe());
+        inputQueue::get().submit(std::move(inputBatch(pId, wHandle).press(vkCode, shiftPress, controlPress, altPress)));
+    }
+    void sendClick(int x, int y, sol::optional<int> buttonType) const
+    {
+        inputQueue::get().submit(std::move(inputBatch(pId, wHandle).click(x, y, buttonType.value_or(1))));
+    }
+    void typeText(const std::string& text) const
+    {
+        inputQueue::get().submit(std::move(inputBatch(pId, wHandle).type(text)));
+    }
+    //Saves what the window is showing as a PNG, the file is written in the background
+    bool screenshot(const std::string& path) const
+    {
+        if (wHandle == 0)
+            return false;
+        return saveScreenshot(getBounds(), path);
+    }
     rect getBounds() const;
 
-    void tick(std::span<const windowHandle> existing) 
+    //Runs the update function of any watch whose file has changed
+    void checkWatches()
     {
-        if (!valid())
+        for (auto& watch : watches)
         {
-            start(existing, wHandle);
-        }
-        if (!checkMonitor())
+			watch.check(*this, describe());
+		}
+    }
+
+    //Makes sure the window exists and is on its monitor, restarting or moving it if not
+    //The known state (if given) must have been queried for the current handle
+    void supervise(std::span<const windowHandle> existing, const windowState* known = nullptr)
+    {
+        if (known ? !known->exists : !valid())
         {
-            //Reset the nudge count if we had to reset the window
-            nudges = appSettings::get().nudges;
+            start(existing, wHandle);
+            //Whatever we knew was about the old window
+            known = nullptr;
         }
-        if (onTick.valid())
+        checkMonitor(known);
+    }
+
+    //Runs the lua tick function and file watches
+    void tick() 
+    {
+        traceSpan span("window tick", describe());
+        //A tick function that is still waiting from an earlier tick is left to finish rather than started again
+        auto& scheduler = luaScheduler::get();
+        if (onTick.valid() && !scheduler.isWaiting(this, &onTick))
 		{
-            auto result = onTick(tickCount++, std::ref(*this));
-            if (result.valid())
-            {
-                //If the function didn't return a bool, assume we continue as normal
-                if (result.get_type() == sol::type::boolean)
-                {
-                    bool val = result;
-                    if (val)
-                        tickCount = 0;
-                }
-            }
-            else
-            {
-                sol::error error = result;
-                std::cout << osm::feat(osm::col, "orange") << "Failed to run tick function: " << error.what() << ".\n" << osm::feat(osm::rst, "all");
-            }
+            auto timer = timeTickPhase("phase=\"lua\"");
+            //If the function didn't return true (including if it is now waiting), assume we continue as normal
+            if (scheduler.run(this, &onTick, "tick function for " + describe(), onTick, tickCount++, std::ref(*this)))
+                tickCount = 0;
 		}
-        for (auto& watch : watches)
         {
-			watch.check(*this);
-		}
+            auto timer = timeTickPhase("phase=\"watches\"");
+            checkWatches();
+        }
 
         if (nudges > 0)
         {
             nudges--;
             static const auto shift = getKeycode("SHIFT");
             //We send a "nudge" to the window to convince it to stop showing the F11 popup
+            inputBatch batch(pId, wHandle);
             for (int i = 0; i < 10; i++)
-                sendMessage(shift);
+                batch.press(shift);
+            inputQueue::get().submit(std::move(batch));
         }
     }
 
-    void updateFromTable(sol::table table) 
+    void updateFromSpec(const windowSpec& spec)
     {
-        onTick = table.get_or("OnTick", sol::protected_function{});
-        onOpen = table.get_or("OnOpen", sol::protected_function{});
-        monitor = table.get_or("Monitor", -1);
-        cacheBuster = table.get_or("CacheBuster", false);
+        id = spec.id;
+        if (playlist != spec.playlist)
+        {
+            //A different playlist starts again from the top, anything preloaded was for the old one
+            playlist = spec.playlist;
+            playlistIndex = 0;
+            nextRotation = std::chrono::steady_clock::now() + (playlist.empty() ? std::chrono::milliseconds(0) : playlist.front().dwell);
+            nextPage.close();
+            rotateInPlace = false;
+        }
+        onTick = spec.onTick;
+        onOpen = spec.onOpen;
+        onUnhealthy = spec.onUnhealthy;
+        monitor = spec.monitor;
+        cacheBuster = spec.cacheBuster;
+        interval = spec.interval;
         watches.clear();
-        if (auto toWatch = table["Watches"].get_or<sol::table>({}); toWatch.valid())
+        for (const auto& w : spec.watches)
         {
-            for (auto& w : toWatch)
-            {
-                watches.push_back(luaWatch::loadFromTable(w.second));
-            }
+            watches.push_back(luaWatch::fromSpec(w));
         }
     }
-    static process loadFromTable(sol::table table) 
+    static process fromSpec(const windowSpec& spec)
     {
 		process p({}, {});
-        p.url = table.get<std::string>("Url");
-        p.updateFromTable(table);
+        p.url = spec.url;
+        p.updateFromSpec(spec);
 		return p;
     }
 
@@ -228,13 +575,11 @@ public:
 				p.luaPress(keys, shift, control, alt);
 			},
             "Click", &process::sendClick,
+            "Type", &process::typeText,
+            "Screenshot", &process::screenshot,
             "Tick", sol::property(&process::tickCount, &process::tickCount),
             "Monitor", sol::readonly(&process::monitor),
-            "Refresh", [](process& p) 
-            {
-                static const auto refresh = getKeycode("F5");
-                p.sendMessage(refresh);
-			}
+            "Refresh", &process::refresh
 		);
     }
 };
\ No newline at end of file
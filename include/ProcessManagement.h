@@ -5,8 +5,10 @@
 #include <span>
 #include <string>
 
-//Starts the given process with the provided arguments
-void createProcess(const std::string& path, const std::string& args);
+//Starts the given process with the provided arguments (and any extra, unsplit arguments)
+//Any descriptors given are passed on to the process as its fd 3, 4 and so on (Linux only)
+//Returns the new process id if the platform provides one, otherwise 0
+processId createProcess(const std::string& path, const std::string& args, std::span<const std::string> extraArgs = {}, std::span<const int> inheritFds = {});
 
 //Returns the PIDs of all active processes
 std::vector<processId> getActiveProcesses(std::string_view processName);
@@ -22,3 +24,35 @@ void closeAllExisting();
 //Starts a new instance of the process and adds it to the process list at the given location
 [[nodiscard]]
 std::optional<std::pair<processId, windowHandle>> startProcess(const std::string& url, std::span<const windowHandle> existing, windowHandle self);
+
+//Starts a new instance for every url at once, then waits for all of their windows together
+//Results are in the same order as the urls, with nullopt for any instance whose window could not be found
+[[nodiscard]]
+std::vector<std::optional<std::pair<processId, windowHandle>>> startProcesses(std::span<const std::string> urls, std::span<const windowHandle> existing);
+
+//A browser that has been started, but whose window may not have appeared yet
+struct pendingLaunch
+{
+    std::string url;
+    //Window class given to the launch's windows, empty if it wasn't isolated
+    std::string windowClass;
+    //The process we started, which is the browser itself when it is isolated
+    processId child = 0;
+};
+
+//Starts a browser without waiting for its window, or returns nothing if the platform can only start browsers by waiting for them (Windows)
+std::optional<pendingLaunch> beginLaunch(const std::string& url, std::span<const std::string> extraArgs = {});
+
+//Finds the windows of the given launches that have appeared and aren't already known, in the same order as the launches
+//Only isolated launches can be told apart, anything else is never found
+std::vector<std::optional<std::pair<processId, windowHandle>>> findLaunchedWindows(std::span<const pendingLaunch> launches, std::span<const windowHandle> known);
+
+//Arguments that open a browser's window off to the side of the desktop, so it never covers a monitor before it can be hidden
+std::vector<std::string> offscreenLaunchArgs();
+
+//Stops a launched browser, if it is only ours
+void closeLaunch(const pendingLaunch& launch);
+
+//Hides the window out of the way (minimised), and shows it again
+void minimiseWindow(windowHandle handle);
+void restoreWindow(windowHandle handle);
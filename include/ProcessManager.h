@@ -2,14 +2,82 @@
 #include "Monitor.h"
 #include "Process.h"
 #include "Settings.h"
+#include "TickScheduler.h"
+#include "Reconcile.h"
+#include "ConfigSnapshot.h"
+#include "StandbyPool.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <array>
 #include <map>
+#include <numeric>
+#include <unordered_map>
 #include "PlatformTypes.h"
 
 class processManager
 {
-    std::vector<process> processes;
+    //Held by pointer so windows stay put (along with anything waiting on them) while others are added or removed
+    std::vector<std::unique_ptr<process>> processes;
     sol::protected_function onTick;
     size_t tickCount = 0;
+    tickScheduler schedule;
+    standbyPool standby;
+    //When the windows were last sampled by the health check
+    std::chrono::steady_clock::time_point lastHealthCheck = std::chrono::steady_clock::now();
+
+    //When the windows are next due to be sampled, if the health check is on
+    std::optional<std::chrono::steady_clock::time_point> healthCheckDue() const
+    {
+        const auto interval = appSettings::get().healthCheckInterval;
+        if (interval <= 0 || processes.empty())
+            return std::nullopt;
+        return lastHealthCheck + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(interval));
+    }
+
+    //Samples every settled window if the health check is due, restarting those found to be unhealthy
+    void checkHealth()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (auto due = healthCheckDue(); !due || now < *due)
+            return;
+        lastHealthCheck = now;
+
+        std::vector<size_t> sampled;
+        std::vector<windowHandle> handles;
+        for (size_t i = 0; i < processes.size(); ++i)
+        {
+            if (processes[i]->isSampleable())
+            {
+                sampled.push_back(i);
+                handles.push_back(processes[i]->getHandle());
+            }
+        }
+        if (sampled.empty())
+            return;
+
+        //Windows cover their monitors, so what is on screen where the window is shows the window's page
+        auto states = queryWindowStates(handles);
+        std::vector<rect> areas;
+        for (const auto& state : states)
+            areas.push_back(state.exists ? state.bounds : rect{ 0, 0, 0, 0 });
+        auto samples = sampleFrames(areas);
+
+        std::vector<size_t> restarting;
+        std::vector<windowHandle> dying;
+        for (size_t k = 0; k < sampled.size(); ++k)
+        {
+            auto& p = *processes[sampled[k]];
+            if (!samples[k] || !p.checkHealth(*samples[k]))
+                continue;
+            std::cout << osm::feat(osm::col, "orange") << "Restarting the window on " << p.describe() << ".\n" << osm::feat(osm::rst, "all");
+            countRestart("reason=\"unhealthy\"");
+            dying.push_back(p.getHandle());
+            p.restart();
+            restarting.push_back(sampled[k]);
+        }
+        if (!restarting.empty())
+            superviseWindows(dying, restarting, true);
+    }
 
     const std::vector<windowHandle>& getExistingHandles(std::span<const windowHandle> otherHandles) const
     {
@@ -17,7 +85,9 @@ class processManager
         static std::vector<windowHandle> handles;
         handles.clear();
         for (const auto& p : processes)
-            handles.push_back(p.getHandle());
+            handles.push_back(p->getHandle());
+        for (auto h : standby.handles())
+            handles.push_back(h);
 
         for (auto h : otherHandles)
         {
@@ -26,10 +96,69 @@ class processManager
         return handles;
     }
 
-    //Takes a list of other windows that may be closed soon, but not yet
-    void tickImpl(std::span<const windowHandle> dyingWindows)
+    //Starts the windows of all the given processes together, rather than waiting on each in turn
+    void launchAll(const std::vector<size_t>& indices, std::span<const windowHandle> dyingWindows)
+    {
+        if (indices.empty())
+            return;
+        traceSpan span("launch windows", std::to_string(indices.size()) + " windows");
+        //Standbys are taken first, only what is left waits for a browser to start
+        std::vector<size_t> cold;
+        for (auto i : indices)
+        {
+            auto& p = *processes[i];
+            if (auto warm = standby.claim(p.getLaunchUrl()))
+            {
+                traceSpan claimed("claim standby", p.getLaunchUrl());
+                p.adopt(std::pair{ warm->pid, warm->handle });
+                if (warm->needsNavigating)
+                    p.navigate(std::string(p.getUrl()));
+            }
+            else
+            {
+                cold.push_back(i);
+            }
+        }
+
+        std::vector<std::string> urls;
+        for (auto i : cold)
+            urls.push_back(processes[i]->getLaunchUrl());
+        auto launched = startProcesses(urls, getExistingHandles(dyingWindows));
+        for (size_t k = 0; k < cold.size(); ++k)
+            processes[cold[k]]->adopt(launched[k]);
+        refillStandby();
+    }
+
+    //Keeps StandbyWindows standbys ready, each for the page of the window it is most likely to replace
+    void refillStandby()
     {
-        auto monitors = getMonitors();
+        std::vector<std::string> wanted;
+        const auto count = processes.empty() ? 0 : std::max(appSettings::get().standbyWindows, 0);
+        for (int k = 0; k < count; ++k)
+            wanted.push_back(processes[k % processes.size()]->getLaunchUrl());
+        standby.refill(wanted);
+    }
+
+    //Places the given process, freshly launched processes have no known state and are queried again
+    void superviseOne(size_t index, const std::vector<size_t>& launched, const std::vector<windowState>& states, std::span<const windowHandle> handles)
+    {
+        auto& p = *processes[index];
+        if (std::find(launched.begin(), launched.end(), index) != launched.end())
+        {
+            //If the launch failed, leave it for the next tick rather than trying again immediately
+            if (p.getHandle() != 0)
+                p.supervise(handles);
+        }
+        else
+        {
+            p.supervise(handles, &states[index]);
+        }
+    }
+
+    //Returns false if the windows were all closed because the monitor count is wrong
+    bool monitorCountValid()
+    {
+        const auto& monitors = getMonitors();
         if (static_cast<int>(monitors.size()) != appSettings::get().monitors)
         {
             switch (appSettings::get().monitorMode)
@@ -38,7 +167,9 @@ class processManager
             {
                 //Close all windows but keep running
                 processes.clear();
-                return;
+                schedule.clear();
+                schedule.add(tickScheduler::globalSlot, std::chrono::seconds(appSettings::get().refreshTime));
+                return false;
             }
             case appSettings::invalidMonitorMode::FAIL:
             {
@@ -50,14 +181,50 @@ class processManager
                 break;
             }
         }
+        return true;
+    }
+
+    //Takes a list of other windows that may be closed soon, but not yet
+    //Only the windows listed in due are checked
+    //If superviseAll is false, only windows that don't exist yet or are part way through being placed are checked, the rest are left to window events
+    void superviseWindows(std::span<const windowHandle> dyingWindows, const std::vector<size_t>& due, bool superviseAll)
+    {
+        std::vector<size_t> checking;
+        for (auto i : due)
+        {
+            if (superviseAll || processes[i]->getHandle() == 0 || processes[i]->isPlacing())
+                checking.push_back(i);
+        }
 
         //Use a reference wrapper as we may want to reassign the handles
         auto handles = std::ref(getExistingHandles(dyingWindows));
 
-        for (auto& p : processes)
+        //Query every checked window up front in one batch, rather than a round trip per window per check
+        std::vector<windowState> states(processes.size());
+        if (!checking.empty())
         {
+            std::vector<windowHandle> checkedHandles;
+            for (auto i : checking)
+                checkedHandles.push_back(processes[i]->getHandle());
+            auto checkedStates = queryWindowStates(checkedHandles);
+            for (size_t k = 0; k < checking.size(); ++k)
+                states[checking[k]] = checkedStates[k];
+        }
+
+        std::vector<size_t> missing;
+        for (auto i : checking)
+        {
+            if (!states[i].exists)
+                missing.push_back(i);
+        }
+        launchAll(missing, dyingWindows);
+        handles = std::ref(getExistingHandles(dyingWindows));
+
+        for (auto i : checking)
+        {
+            auto& p = *processes[i];
             auto originalHandle = p.getHandle();
-            p.tick(handles.get());
+            superviseOne(i, missing, states, handles.get());
             if (p.getHandle() != originalHandle)
 			{
 				//If the handle has changed, we need to update the list
@@ -65,20 +232,47 @@ class processManager
 			}
         }
 
-        if (onTick.valid())
+        if (eventDriven())
         {
-            auto result = onTick(tickCount++);
-            if (result.valid())
-            {
-                bool val = result;
-                if (val)
-                    tickCount = 0;
-            }
-            else
-            {
-                sol::error error = result;
-                std::cout << osm::feat(osm::col, "orange") << "Failed to run global tick function: " << error.what() << ".\n" << osm::feat(osm::rst, "all");
-            }
+            for (auto i : due)
+                watchWindow(processes[i]->getHandle());
+        }
+    }
+
+    //Whether windows are left to window events, which needs EventDriven and a platform (and connection) that reports them
+    //Otherwise every window is checked each tick, as nothing else would notice one that closed or moved
+    static bool eventDriven()
+    {
+        return appSettings::get().eventDriven && windowEventSource() != -1;
+    }
+
+    //Only the windows listed in due are ticked, the global tick and monitor count check only run if runGlobal is set
+    void tickImpl(std::span<const windowHandle> dyingWindows, const std::vector<size_t>& due, bool runGlobal, bool superviseAll = true)
+    {
+        traceSpan span("tick");
+        if (runGlobal)
+        {
+            auto timer = timeTickPhase("phase=\"monitors\"");
+            if (!monitorCountValid())
+                return;
+        }
+
+        {
+            auto timer = timeTickPhase("phase=\"supervise\"");
+            superviseWindows(dyingWindows, due, superviseAll);
+        }
+        for (auto i : due)
+            processes[i]->tick();
+
+        if (!runGlobal)
+            return;
+
+        auto& scheduler = luaScheduler::get();
+        if (onTick.valid() && !scheduler.isWaiting(this, &onTick))
+        {
+            auto timer = timeTickPhase("phase=\"lua\"");
+            if (scheduler.run(this, &onTick, "global tick function", onTick, tickCount++))
+                tickCount = 0;
         }
     }
 
@@ -91,143 +285,323 @@ public:
     {
         for (auto& p : processes)
         {
-            p.setTick(value.value_or(0));
+            p->setTick(value.value_or(0));
         }
         tickCount = value.value_or(0);
     }
 
+    //Runs whichever window ticks (and the global tick) are due
     void tick()
     {
-        tickImpl({});
+        auto timer = timeTick();
+        const auto requestsBefore = windowSystemRequests();
+        auto due = schedule.takeDue();
+        bool runGlobal = std::erase(due, tickScheduler::globalSlot) != 0;
+        //Several windows may share a schedule, keep them in monitor order
+        std::sort(due.begin(), due.end());
+        tickImpl({}, due, runGlobal, !eventDriven());
+        checkHealth();
+        updateStandby();
+        countTickRequests(windowSystemRequests() - requestsBefore);
     }
 
-    void loadFromTable(sol::state& table, std::string_view config)
+    //Picks up standby windows that have appeared, and starts more if any were lost
+    void updateStandby()
     {
-        sol::table data = table["Configurations"][config].get_or(sol::table{});
-        if (!data.valid())
-            throw std::runtime_error("Configurations table not found.");
+        standby.update(getExistingHandles({}));
+        refillStandby();
+    }
 
-        auto oldProcesses = std::move(processes);
-        processes.clear();
+    //When the next tick (or a placement step, page load timeout, playlist change or health check) is due, if anything is scheduled at all
+    std::optional<tickScheduler::clock::time_point> nextDue() const
+    {
+        auto result = schedule.nextDue();
+        for (const auto& p : processes)
+        {
+            if (auto by = p->readyBy(); by && (!result || *by < *result))
+                result = by;
+            if (auto by = p->placementDue(); by && (!result || *by < *result))
+                result = by;
+            if (auto by = p->rotationDue(); by && (!result || *by < *result))
+                result = by;
+        }
+        if (auto by = healthCheckDue(); by && (!result || *by < *result))
+            result = by;
+        return result;
+    }
 
-        std::vector<std::pair<int, process>> indexedProcesses;
+    //Moves every playlist on that is due, placing any window that was swapped for its next page
+    void checkPlaylists()
+    {
+        std::vector<size_t> rotating;
+        std::vector<windowHandle> nextPages;
+        for (size_t i = 0; i < processes.size(); ++i)
+        {
+            if (processes[i]->hasPlaylist())
+            {
+                rotating.push_back(i);
+                nextPages.push_back(processes[i]->nextPageHandle());
+            }
+        }
+        if (rotating.empty())
+            return;
 
-        onTick = data["OnTick"];
+        auto states = queryWindowStates(nextPages);
+        const auto now = std::chrono::steady_clock::now();
+        std::vector<size_t> swapped;
+        for (size_t k = 0; k < rotating.size(); ++k)
+        {
+            if (processes[rotating[k]]->rotate(getExistingHandles({}), states[k], now))
+                swapped.push_back(rotating[k]);
+        }
+        if (!swapped.empty())
+            superviseWindows({}, swapped, true);
+    }
 
-        for (auto& [k, v] : data)
+    //Checks every window whose placement step has gone unconfirmed for too long, sending it again or moving on
+    //Otherwise a step the window manager never confirms would wait for the window's next tick
+    void checkPlacements()
+    {
+        std::vector<size_t> due;
+        const auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < processes.size(); ++i)
         {
-            //If this isn't a table, skip it
-            if (v.get_type() != sol::type::table)
-                continue;
+            if (auto by = processes[i]->placementDue(); by && *by <= now)
+                due.push_back(i);
+        }
+        if (!due.empty())
+            superviseWindows({}, due, true);
+    }
 
-            bool enabled = false;
-            auto enabledFunc = v.as<sol::table>().get_or<sol::protected_function>("Enabled", {});
-            if (enabledFunc.valid())
+    //Runs OnOpen for every newly opened window whose page has loaded (or run out of time to)
+    void checkReadiness()
+    {
+        std::vector<size_t> waiting;
+        std::vector<windowHandle> handles;
+        for (size_t i = 0; i < processes.size(); ++i)
+        {
+            if (processes[i]->readyBy())
             {
-                auto result = enabledFunc();
-				if (result.valid())
-				{
-					enabled = result;
-				}
-				else
-				{
-					sol::error error = result;
-					std::cout << osm::feat(osm::col, "orange") << "Failed to run Enabled function: " << error.what() << ".\n" << osm::feat(osm::rst, "all");
-                    continue;
-				}
+                waiting.push_back(i);
+                handles.push_back(processes[i]->getHandle());
             }
-			else
-			{
-				enabled = v.as<sol::table>()["Enabled"].get_or(true);
-			}
+        }
+        if (waiting.empty())
+            return;
+        auto states = queryWindowStates(handles);
+        const auto now = std::chrono::steady_clock::now();
+        for (size_t k = 0; k < waiting.size(); ++k)
+            processes[waiting[k]]->checkReady(states[k], now);
+    }
 
-            //If this isn't enabled, skip it
-            if (enabled)
+    //Runs the watches of every window, only watches whose file has changed do anything
+    void checkWatches()
+    {
+        for (auto& p : processes)
+            p->checkWatches();
+    }
+
+    //Restarts the windows of any of our processes that exited, without waiting for the next tick
+    void onProcessesExited(std::span<const processId> exited)
+    {
+        standby.onProcessesExited(exited);
+        std::vector<size_t> missing;
+        for (size_t i = 0; i < processes.size(); ++i)
+        {
+            auto pid = processes[i]->getProcessId();
+            if (pid != 0 && std::find(exited.begin(), exited.end(), pid) != exited.end())
             {
-                if (!k.is<int>())
-                {
-                    std::cout << osm::feat(osm::col, "orange") << "Warning: Process key \"" << v.as<std::string>() << "\" is not an integer. It will not be considered.\n" << osm::feat(osm::rst, "all");
-                }
-                int key = k.as<int>();
-
-                bool forceLoad = false;
-                //If this has been set to always reload, set it to do so
-                if (v.as<sol::table>()["ForceLoad"].valid())
-					forceLoad = v.as<sol::table>()["ForceLoad"];
-
-                //Otherwise, if a process already has this url, swap it back in and do not reload but still update it
-                if (!forceLoad && v.as<sol::table>()["Url"].valid())
-                {
-                    auto url = v.as<sol::table>()["Url"].get<std::string>();
-                    forceLoad = true;
-                    for (auto it = oldProcesses.begin(); it != oldProcesses.end(); ++it)
-					{
-						if (it->getUrl() == url)
-						{
-                            auto temp = std::move(*it);
-                            temp.updateFromTable(v);
-                            oldProcesses.erase(it);
-                            forceLoad = false;
-                            indexedProcesses.emplace_back(key, std::move(temp));
-							break;
-						}
-					}
-                }
-                if (forceLoad)
-                    indexedProcesses.emplace_back(key, process::loadFromTable(v));
+                std::cout << osm::feat(osm::col, "orange") << "The process for monitor " << processes[i]->monitor << " exited, restarting it.\n" << osm::feat(osm::rst, "all");
+                countRestart("reason=\"exited\"");
+                processes[i]->detach();
+                missing.push_back(i);
             }
         }
+        if (missing.empty())
+            return;
+
+        launchAll(missing, {});
+        auto handles = std::ref(getExistingHandles({}));
+        for (auto i : missing)
+        {
+            superviseOne(i, missing, {}, handles.get());
+            handles = std::ref(getExistingHandles({}));
+        }
+    }
 
-        //Order by insertion
-        std::sort(indexedProcesses.begin(), indexedProcesses.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    //Checks only the windows affected by the given events
+    void onWindowEvents(const windowEvents& events)
+    {
+        if (events.empty())
+            return;
 
-        //For every process with an unspecified monitor, give it the first unused monitor
-        for (auto& [k, p] : indexedProcesses)
+        auto isAffected = [&](const std::unique_ptr<process>& p)
         {
-            if (p.monitor == -1)
-            {
-                //Find the lowest unused monitor index
-                bool found = true;
-                int index = 0;
-                while (found)
-                {
-                    found = false;
-                    for (auto& [u, m] : indexedProcesses)
-                    {
-                        if (m.monitor == index)
-                        {
-                            found = true;
-                            index++;
-                            break;
-                        }
-                    }
-                }
-                p.monitor = index;
-            }
+            //Windows that failed to start are left to the next tick, otherwise every event would relaunch them
+            if (p->getHandle() == 0)
+                return false;
+            //A change to the client list may mean one of our windows went away without us seeing it, so check everything
+            return events.clientListChanged ||
+                std::find(events.changed.begin(), events.changed.end(), p->getHandle()) != events.changed.end();
+        };
+        if (std::none_of(processes.begin(), processes.end(), isAffected))
+            return;
+
+        auto handles = std::ref(getExistingHandles({}));
+        auto states = queryWindowStates(std::span(handles.get()).first(processes.size()));
+
+        std::vector<size_t> missing;
+        for (size_t i = 0; i < processes.size(); ++i)
+        {
+            if (isAffected(processes[i]) && !states[i].exists)
+                missing.push_back(i);
+        }
+        std::vector<bool> affected;
+        for (auto& p : processes)
+            affected.push_back(isAffected(p));
+        launchAll(missing, {});
+        handles = std::ref(getExistingHandles({}));
+
+        for (size_t i = 0; i < processes.size(); ++i)
+        {
+            auto& p = *processes[i];
+            auto originalHandle = p.getHandle();
+            if (!affected[i])
+                continue;
+
+            superviseOne(i, missing, states, handles.get());
+            if (p.getHandle() != originalHandle)
+                handles = std::ref(getExistingHandles({}));
         }
+    }
 
-        //Remove any with a monitor index greater than the monitor count
-        indexedProcesses.erase(std::remove_if(indexedProcesses.begin(), indexedProcesses.end(), 
-            [](const auto& p) { return p.second.monitor >= appSettings::get().monitors || p.second.monitor < 0; }), indexedProcesses.end());
+    //Places every window again straight away when the monitors change, rather than waiting for their next tick
+    void onMonitorsChanged()
+    {
+        std::cout << osm::feat(osm::col, "orange") << "The monitor layout changed, rearranging windows.\n" << osm::feat(osm::rst, "all");
+        if (!monitorCountValid())
+            return;
+        std::vector<size_t> all(processes.size());
+        std::iota(all.begin(), all.end(), size_t(0));
+        superviseWindows({}, all, true);
+    }
 
-        //Sort by monitor
-        std::sort(indexedProcesses.begin(), indexedProcesses.end(), [](const auto& a, const auto& b) { return a.second.monitor < b.second.monitor; });
+    //Returns true once the given window is open and on its monitor, for the configuration itself this means every window
+    bool windowReady(luaScheduler::owner who) const
+    {
+        auto ready = [](const std::unique_ptr<process>& p) { return p->isPlaced(); };
+        if (who == this)
+            return std::all_of(processes.begin(), processes.end(), ready);
+        for (const auto& p : processes)
+        {
+            if (p.get() == who)
+                return ready(p);
+        }
+        //The window has gone, so there is nothing left to wait for
+        return true;
+    }
 
-        processes.reserve(indexedProcesses.size());
+    //Replaces the windows with those of the given configuration, changing as little as possible (see planReconciliation)
+    //Windows that are kept as they were keep their schedule and anything still waiting on them
+    void apply(const configSnapshot& config)
+    {
+        //The old global tick function is being replaced
+        luaScheduler::get().cancel(this);
+        onTick = config.onTick;
 
-        for (auto& [k, p] : indexedProcesses)
+        std::vector<windowIdentity> current;
+        current.reserve(processes.size());
+        for (const auto& p : processes)
+            current.push_back(p->identity());
+        const auto plan = planReconciliation(current, config.windows);
+
+        //When each window was next due, so kept windows stay on their cadence
+        std::unordered_map<const process*, tickScheduler::clock::time_point> dueTimes;
+        for (const auto& [slot, due] : schedule.pending())
         {
-			processes.emplace_back(std::move(p));
-		}
+            if (slot < processes.size())
+                dueTimes[processes[slot].get()] = due;
+        }
 
-        //Store the old handles so we don't double capture them
+        auto oldProcesses = std::move(processes);
+        processes.clear();
+        processes.resize(config.windows.size());
+
+        //Store the handles of windows being closed or reopened so we don't double capture them
         static std::vector<windowHandle> dyingHandles;
         dyingHandles.clear();
-        for (auto& p : oldProcesses)
-		{
-			dyingHandles.push_back(p.getHandle());
-		}
+        //Windows that need checking straight away
+        std::vector<size_t> changed;
+        std::array<size_t, static_cast<size_t>(reconcileStep::action::COUNT)> counts{};
+
+        using action = reconcileStep::action;
+        for (const auto& step : plan)
+        {
+            counts[static_cast<size_t>(step.what)]++;
+            if (step.what == action::CLOSE)
+            {
+                //Closed once the old list goes out of scope
+                dyingHandles.push_back(oldProcesses[step.current]->getHandle());
+                continue;
+            }
 
-        tickImpl(dyingHandles);
+            const auto& spec = config.windows[step.next];
+            auto& p = processes[step.next];
+            if (step.what == action::LAUNCH)
+            {
+                p = std::make_unique<process>(process::fromSpec(spec));
+                changed.push_back(step.next);
+                continue;
+            }
+
+            p = std::move(oldProcesses[step.current]);
+            p->updateFromSpec(spec);
+            switch (step.what)
+            {
+            case action::NAVIGATE:
+            {
+                auto handle = p->getHandle();
+                if (!p->navigate(spec.url))
+                    dyingHandles.push_back(handle);
+                changed.push_back(step.next);
+                break;
+            }
+            case action::RESTART:
+                countRestart("reason=\"reload\"");
+                dyingHandles.push_back(p->getHandle());
+                p->restart();
+                changed.push_back(step.next);
+                break;
+            case action::MOVE:
+                changed.push_back(step.next);
+                break;
+            default:
+                break;
+            }
+        }
+        std::sort(changed.begin(), changed.end());
+
+        std::cout << "Configuration applied: " << counts[static_cast<size_t>(action::KEEP)] << " kept, "
+            << counts[static_cast<size_t>(action::MOVE)] << " moved, "
+            << counts[static_cast<size_t>(action::NAVIGATE)] << " navigated, "
+            << counts[static_cast<size_t>(action::RESTART)] << " restarted, "
+            << counts[static_cast<size_t>(action::LAUNCH)] << " launched, "
+            << counts[static_cast<size_t>(action::CLOSE)] << " closed.\n";
+
+        //Changed windows are checked straight away, then settle into their own schedule
+        tickImpl(dyingHandles, changed, true);
+        oldProcesses.clear();
+
+        schedule.clear();
+        schedule.add(tickScheduler::globalSlot, std::chrono::seconds(appSettings::get().refreshTime));
+        for (size_t i = 0; i < processes.size(); ++i)
+        {
+            auto due = dueTimes.find(processes[i].get());
+            if (due != dueTimes.end() && !std::binary_search(changed.begin(), changed.end(), i))
+                schedule.add(i, processes[i]->getInterval(), due->second);
+            else
+                schedule.add(i, processes[i]->getInterval());
+        }
+        refillStandby();
     }
 };
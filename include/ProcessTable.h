@@ -0,0 +1,57 @@
+#pragma once
+#include "PlatformTypes.h"
+#include <array>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <dirent.h>
+
+//A cached view of the running processes (Linux only)
+//Rescanning only reads processes that weren't there last time, everything else is kept from the previous scan
+class processTable
+{
+public:
+    struct entry
+    {
+        processId pid = 0;
+        processId parent = 0;
+        //Start time in clock ticks since boot, which together with the pid identifies a process even if the pid is reused
+        unsigned long long startTime = 0;
+        std::string name;
+    };
+
+private:
+    std::unordered_map<processId, entry> entries;
+    //Entries not seen in the latest scan are dropped
+    std::unordered_map<processId, size_t> lastSeen;
+    size_t scanCount = 0;
+    DIR* proc = nullptr;
+    //Reused for every read, /proc/<pid>/stat is always well under this
+    std::array<char, 1024> buffer{};
+
+    processTable() = default;
+    ~processTable();
+
+    bool readStat(processId pid, entry& result);
+    //Makes sure a cached entry still refers to the same process, dropping it if the pid was reused
+    const entry* verify(processId pid);
+
+public:
+    processTable(const processTable&) = delete;
+    processTable& operator=(const processTable&) = delete;
+
+    static processTable& get();
+
+    //Brings the table up to date with /proc
+    void scan();
+
+    //Returns every process with the given name (or every process if the name is empty), as of the last scan
+    std::vector<processId> withName(std::string_view name);
+
+    //Returns the name of the process, reading it if it isn't known yet. Empty if there is no such process
+    std::string nameOf(processId pid);
+
+    //Returns true if the process is the ancestor or one of its descendants, as of the last scan
+    bool isDescendantOf(processId pid, processId ancestor);
+};
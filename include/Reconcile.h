@@ -0,0 +1,118 @@
+#pragma once
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ConfigSnapshot.h"
+
+//What an open window is, as far as matching it to a new configuration goes
+struct windowIdentity
+{
+    //Empty if the window wasn't given an Id
+    std::string_view id;
+    std::string_view url;
+    int monitor = -1;
+};
+
+//One operation needed to get from the open windows to a new configuration
+struct reconcileStep
+{
+    enum class action
+    {
+        KEEP,       //Only its callbacks change
+        MOVE,       //Same page, different monitor
+        NAVIGATE,   //Same window, different page
+        RESTART,    //Same window, but it is always reopened (ForceLoad)
+        LAUNCH,     //A window that wasn't open before
+        CLOSE,      //A window that is no longer wanted
+        COUNT       //Not an action, the number of actions (new ones go above)
+    };
+    action what = action::KEEP;
+    //Index into the open windows, unused for LAUNCH
+    size_t current = 0;
+    //Index into the new configuration's windows, unused for CLOSE
+    size_t next = 0;
+};
+
+//Works out the least disruptive way to turn the open windows into the new configuration's windows
+//Windows are matched by Id first, then by url and monitor, then by url alone (a move), then by monitor alone (a navigation)
+//Windows that both have an Id only ever match if the Ids agree
+//Closes come first in the plan, the rest follow the order of the new windows
+inline std::vector<reconcileStep> planReconciliation(std::span<const windowIdentity> current, std::span<const windowSpec> next)
+{
+    constexpr size_t unmatched = std::numeric_limits<size_t>::max();
+    std::vector<windowIdentity> wanted;
+    wanted.reserve(next.size());
+    for (const auto& spec : next)
+        wanted.push_back({ spec.id, spec.url, spec.monitor });
+
+    std::vector<size_t> matchOf(next.size(), unmatched);
+    std::vector<bool> taken(current.size(), false);
+
+    auto compatible = [&](size_t c, size_t n)
+    {
+        return current[c].id.empty() || wanted[n].id.empty() || current[c].id == wanted[n].id;
+    };
+
+    //Matches whatever is still unmatched on the given key, windows without a key are left for a later pass
+    auto matchBy = [&](auto keyOf)
+    {
+        std::unordered_multimap<std::string, size_t> available;
+        for (size_t c = 0; c < current.size(); ++c)
+        {
+            if (taken[c])
+                continue;
+            if (auto key = keyOf(current[c]))
+                available.emplace(std::move(*key), c);
+        }
+        for (size_t n = 0; n < wanted.size(); ++n)
+        {
+            if (matchOf[n] != unmatched)
+                continue;
+            auto key = keyOf(wanted[n]);
+            if (!key)
+                continue;
+            auto [first, last] = available.equal_range(*key);
+            for (auto it = first; it != last; ++it)
+            {
+                if (!taken[it->second] && compatible(it->second, n))
+                {
+                    matchOf[n] = it->second;
+                    taken[it->second] = true;
+                    break;
+                }
+            }
+        }
+    };
+
+    matchBy([](const windowIdentity& w) { return w.id.empty() ? std::nullopt : std::optional<std::string>(w.id); });
+    matchBy([](const windowIdentity& w) { return std::optional<std::string>(std::to_string(w.monitor) + '\n' + std::string(w.url)); });
+    matchBy([](const windowIdentity& w) { return std::optional<std::string>(w.url); });
+    matchBy([](const windowIdentity& w) { return std::optional<std::string>(std::to_string(w.monitor)); });
+
+    using action = reconcileStep::action;
+    std::vector<reconcileStep> plan;
+    for (size_t c = 0; c < current.size(); ++c)
+    {
+        if (!taken[c])
+            plan.push_back({ action::CLOSE, c, 0 });
+    }
+    for (size_t n = 0; n < wanted.size(); ++n)
+    {
+        const auto c = matchOf[n];
+        if (c == unmatched)
+            plan.push_back({ action::LAUNCH, 0, n });
+        else if (next[n].forceLoad)
+            plan.push_back({ action::RESTART, c, n });
+        else if (current[c].url != wanted[n].url)
+            plan.push_back({ action::NAVIGATE, c, n });
+        else if (current[c].monitor != wanted[n].monitor)
+            plan.push_back({ action::MOVE, c, n });
+        else
+            plan.push_back({ action::KEEP, c, n });
+    }
+    return plan;
+}
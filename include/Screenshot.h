@@ -0,0 +1,65 @@
+#pragma once
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include "osmanip/manipulators/colsty.hpp"
+#include "FrameSample.h"
+#include "Png.h"
+#include "Rect.h"
+#include "Settings.h"
+#include "TimeCodes.h"
+#include "Trace.h"
+#include "WorkerPool.h"
+
+//Captures the area of the screen now, and saves it as a PNG at the path in the background
+//Returns false if the area couldn't be captured, or too many screenshots are already waiting to be saved
+//The file is written under a temporary name and then renamed, so a half written file is never seen at the path
+inline bool saveScreenshot(rect area, const std::string& pathPattern)
+{
+    auto path = expandTimeCodes(pathPattern, std::time(nullptr));
+    auto frame = captureArea(area);
+    if (!frame)
+    {
+        std::cout << osm::feat(osm::col, "orange") << "Unable to capture the screen for " << path << ".\n" << osm::feat(osm::rst, "all");
+        return false;
+    }
+
+    //Shared so the job can be copied into the queue without copying the pixels
+    auto captured = std::make_shared<capturedFrame>(std::move(*frame));
+    bool queued = workerPool::get().post([captured, path]()
+    {
+        traceSpan span("save screenshot", path);
+        auto fail = [&](const std::string& why)
+        {
+            std::cout << osm::feat(osm::col, "red") << "Unable to save screenshot " << path << ": " << why << ".\n" << osm::feat(osm::rst, "all");
+        };
+        auto png = encodePng(*captured, appSettings::snapshot()->screenshotCompression);
+        if (!png)
+            return fail("encoding failed");
+
+        std::error_code error;
+        const std::filesystem::path target(path);
+        if (target.has_parent_path())
+            std::filesystem::create_directories(target.parent_path(), error);
+        auto temporary = target;
+        temporary += ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(png->data()), static_cast<std::streamsize>(png->size()));
+            if (!file)
+                return fail("the file couldn't be written");
+        }
+        std::filesystem::rename(temporary, target, error);
+        if (error)
+        {
+            std::filesystem::remove(temporary, error);
+            return fail("the file couldn't be renamed");
+        }
+    });
+    if (!queued)
+        std::cout << osm::feat(osm::col, "orange") << "Too many screenshots are waiting to be saved, skipping " << path << ".\n" << osm::feat(osm::rst, "all");
+    return queued;
+}
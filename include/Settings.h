@@ -1,6 +1,8 @@
 #pragma once
 #include <string>
 #include <array>
+#include <atomic>
+#include <memory>
 #include <sol/sol.hpp>
 
 struct appSettings
@@ -34,26 +36,84 @@ struct appSettings
     //How many seconds to wait before checking files again
     int refreshTime = 2;
 
+    //Whether to react to window changes as they happen instead of checking windows every tick (Linux only)
+    bool eventDriven = false;
+
     //Whether to close all instances of the process on start up
     bool closeAllOnStart = true;
-    //How long to wait after starting a process before trying to pull its PID/HWND
-    int loadTime = 1;
+    //The longest we wait for a started process's window to appear
+    int launchTimeout = 30;
+    //The longest we wait for a newly opened window's page to load before running OnOpen anyway, in seconds
+    double readyTimeout = 10;
+    //Whether each window gets its own browser profile and window class, so it can be told apart from the others (Linux only)
+    bool isolateWindows = false;
+    //Where isolated browser profiles are kept, profiles are reused between launches
+    std::string profileDirectory = "KioskProfiles";
+    //Whether isolated browsers are started with a DevTools pipe, so pages can be navigated and reloaded without restarting them (Linux only)
+    bool devTools = false;
+    //How many browsers are kept started and minimised, ready to take over from a window that dies (Linux only)
+    int standbyWindows = 0;
 
     //Which configuration to use
     std::string configuration = "Default";
 
-    //How many times to a nudge a window after fullscreening
+    //How many times to a nudge a window after fullscreening (Windows only)
     int nudges = 3;
 
+    //How often windows are sampled to check they are still drawing, in seconds (0 to never check)
+    double healthCheckInterval = 0;
+    //How many samples in a row must be blank, or the same, for a window to be unhealthy (0 to not check for it)
+    int healthBlankSamples = 3;
+    int healthFrozenSamples = 0;
+    //Whether unhealthy windows without an OnUnhealthy function are restarted
+    bool healthRestart = true;
+
+    //The zlib level screenshots are compressed at, from 0 (fastest) to 9 (smallest)
+    int screenshotCompression = 6;
+
+    //Where metrics are served, a Unix socket path and/or a localhost port (empty and 0 to not serve them)
+    std::string metricsSocket = "";
+    int metricsPort = 0;
+
+    //How many events each thread keeps for the trace (0 to not record one)
+    int traceBufferSize = 0;
+    //Where the trace is saved, strftime codes are replaced with the time it was saved
+    std::string traceFile = "KioskTrace_%Y-%m-%d_%H-%M-%S.json";
+
     //How long we wait for keypresses
     int keyTimeMs = 50;
 
-    static appSettings& get()
+    //The longest a lua callback may run between waits before it is stopped, in milliseconds (0 for no limit)
+    int callbackTimeBudgetMs = 0;
+    //The most lua instructions a callback may run between waits before it is stopped (0 for no limit)
+    int callbackInstructionBudget = 0;
+    //How often callback timings are printed, in seconds (0 to never print them)
+    int profileLogInterval = 0;
+    //Whether the profile counts the instructions each callback runs, which means turning off LuaJIT's compiler
+    bool profileInstructions = false;
+
+private:
+    //The settings in use, replaced as a whole when a new configuration is published
+    static std::atomic<std::shared_ptr<const appSettings>> published;
+
+public:
+    //For the main thread, the reference lasts until the next configuration is published (which only the main thread does)
+    static const appSettings& get()
 	{
-		static appSettings settings;
-		return settings;
+		return *published.load();
 	}
 
+    //For other threads, the snapshot can be kept for as long as needed
+    static std::shared_ptr<const appSettings> snapshot()
+    {
+        return published.load();
+    }
+
+    static void publish(std::shared_ptr<const appSettings> settings)
+    {
+        published.store(std::move(settings));
+    }
+
     void loadFromTable(sol::state& table)
     {
         executableName = table.get_or("ExecutableName", executableName);
@@ -73,10 +133,35 @@ struct appSettings
 
 		monitors = table.get_or("Monitors", monitors);
 		refreshTime = table.get_or("RefreshTime", refreshTime);
+        eventDriven = table.get_or("EventDriven", eventDriven);
 		closeAllOnStart = table.get_or("CloseAllOnStart", closeAllOnStart);
-		loadTime = table.get_or("LoadTime", loadTime);
+        launchTimeout = table.get_or("LaunchTimeout", launchTimeout);
+        readyTimeout = table.get_or("ReadyTimeout", readyTimeout);
+        isolateWindows = table.get_or("IsolateWindows", isolateWindows);
+        profileDirectory = table.get_or("ProfileDirectory", profileDirectory);
+        devTools = table.get_or("DevTools", devTools);
+        standbyWindows = table.get_or("StandbyWindows", standbyWindows);
         configuration = table.get_or("Configuration", configuration);
         nudges = table.get_or("Nudges", nudges);
         keyTimeMs = table.get_or("KeyTimeMs", keyTimeMs);
+        screenshotCompression = table.get_or("ScreenshotCompression", screenshotCompression);
+        metricsSocket = table.get_or("MetricsSocket", metricsSocket);
+        metricsPort = table.get_or("MetricsPort", metricsPort);
+        traceBufferSize = table.get_or("TraceBufferSize", traceBufferSize);
+        traceFile = table.get_or("TraceFile", traceFile);
+        if (auto health = table["HealthCheck"].get_or<sol::table>({}); health.valid())
+        {
+            healthCheckInterval = health.get_or("Interval", healthCheckInterval);
+            healthBlankSamples = health.get_or("BlankSamples", healthBlankSamples);
+            healthFrozenSamples = health.get_or("FrozenSamples", healthFrozenSamples);
+            healthRestart = health.get_or("Restart", healthRestart);
+        }
+        callbackTimeBudgetMs = table.get_or("CallbackTimeBudgetMs", callbackTimeBudgetMs);
+        callbackInstructionBudget = table.get_or("CallbackInstructionBudget", callbackInstructionBudget);
+        profileLogInterval = table.get_or("ProfileLogInterval", profileLogInterval);
+        profileInstructions = table.get_or("ProfileInstructions", profileInstructions);
     }
 };
+
+//Starts out with the defaults, until the first configuration is loaded
+inline std::atomic<std::shared_ptr<const appSettings>> appSettings::published{ std::make_shared<const appSettings>() };
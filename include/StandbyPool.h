@@ -0,0 +1,199 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include "osmanip/manipulators/colsty.hpp"
+#include "DevTools.h"
+#include "PlatformTypes.h"
+#include "ProcessManagement.h"
+#include "Settings.h"
+
+//Browsers started ahead of time and kept minimised, so a window that dies (or must be reopened) can take one over instead of waiting for a browser to start
+//Standbys are started in the background, nothing waits for their windows to appear
+class standbyPool
+{
+    struct standby
+    {
+        pendingLaunch launch;
+        //Zero until the window has appeared
+        processId pid = 0;
+        windowHandle handle = 0;
+        //When we give up waiting for the window
+        std::chrono::steady_clock::time_point deadline;
+    };
+    std::vector<standby> standbys;
+
+    //Standbys can be told to load another page when they have DevTools, otherwise they are only any use for the page they opened with
+    static bool canNavigate(const standby& s)
+    {
+        auto channel = devTools::get().find(s.pid);
+        return channel && channel->isAttached();
+    }
+
+    static void close(const standby& s)
+    {
+        closeLaunch(s.launch);
+    }
+
+public:
+    standbyPool() = default;
+    standbyPool(const standbyPool&) = delete;
+    standbyPool& operator=(const standbyPool&) = delete;
+    ~standbyPool()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        for (const auto& s : standbys)
+            close(s);
+        standbys.clear();
+    }
+
+    //Starts standbys until there is one for each of the given urls, closing any that are no longer wanted
+    //Without DevTools a standby only stands in for its own url, with DevTools any standby will do
+    void refill(std::span<const std::string> wanted)
+    {
+        //Standbys need isolated browsers, otherwise their windows can't be told apart from anything else
+        if (!appSettings::get().isolateWindows)
+        {
+            clear();
+            return;
+        }
+
+        std::vector<bool> covered(wanted.size(), false);
+        std::vector<bool> keep(standbys.size(), false);
+        //Standbys opened on the right page are matched first, so they aren't spent on pages another could be navigated to
+        for (size_t i = 0; i < standbys.size(); ++i)
+        {
+            for (size_t w = 0; w < wanted.size(); ++w)
+            {
+                if (!covered[w] && standbys[i].launch.url == wanted[w])
+                {
+                    covered[w] = keep[i] = true;
+                    break;
+                }
+            }
+        }
+        for (size_t i = 0; i < standbys.size(); ++i)
+        {
+            if (keep[i] || !appSettings::get().devTools)
+                continue;
+            auto w = std::find(covered.begin(), covered.end(), false);
+            if (w == covered.end())
+                break;
+            *w = keep[i] = true;
+        }
+
+        for (size_t i = standbys.size(); i-- > 0;)
+        {
+            if (!keep[i])
+            {
+                close(standbys[i]);
+                standbys.erase(standbys.begin() + i);
+            }
+        }
+
+        const auto args = offscreenLaunchArgs();
+        for (size_t w = 0; w < wanted.size(); ++w)
+        {
+            if (covered[w])
+                continue;
+            auto launch = beginLaunch(wanted[w], args);
+            //The platform can't start browsers in the background
+            if (!launch)
+                return;
+            standbys.push_back({ std::move(*launch), 0, 0, std::chrono::steady_clock::now() + std::chrono::seconds(appSettings::get().launchTimeout) });
+        }
+    }
+
+    //Picks up the windows of standbys that have appeared, and gives up on any that took too long
+    void update(std::span<const windowHandle> known)
+    {
+        std::vector<pendingLaunch> launching;
+        std::vector<size_t> indices;
+        for (size_t i = 0; i < standbys.size(); ++i)
+        {
+            if (standbys[i].handle == 0)
+            {
+                launching.push_back(standbys[i].launch);
+                indices.push_back(i);
+            }
+        }
+        if (launching.empty())
+            return;
+
+        auto found = findLaunchedWindows(launching, known);
+        const auto now = std::chrono::steady_clock::now();
+        for (size_t k = indices.size(); k-- > 0;)
+        {
+            auto& s = standbys[indices[k]];
+            if (found[k])
+            {
+                s.pid = found[k]->first;
+                s.handle = found[k]->second;
+                minimiseWindow(s.handle);
+            }
+            else if (now >= s.deadline)
+            {
+                std::cout << osm::feat(osm::col, "orange") << "A standby window for " << s.launch.url << " did not appear, it will be started again.\n" << osm::feat(osm::rst, "all");
+                close(s);
+                standbys.erase(standbys.begin() + indices[k]);
+            }
+        }
+    }
+
+    //Forgets standbys whose browsers have exited
+    void onProcessesExited(std::span<const processId> exited)
+    {
+        std::erase_if(standbys, [&](const standby& s)
+        {
+            return std::find(exited.begin(), exited.end(), s.launch.child) != exited.end() ||
+                (s.pid != 0 && std::find(exited.begin(), exited.end(), s.pid) != exited.end());
+        });
+    }
+
+    struct claimed
+    {
+        processId pid;
+        windowHandle handle;
+        //Whether the standby is showing another page, and needs navigating to the one wanted
+        bool needsNavigating;
+    };
+
+    //Takes a standby ready to show the url, if there is one, and shows its window again
+    std::optional<claimed> claim(const std::string& url)
+    {
+        auto take = [&](std::vector<standby>::iterator it, bool navigate)
+        {
+            claimed result{ it->pid, it->handle, navigate };
+            standbys.erase(it);
+            restoreWindow(result.handle);
+            return result;
+        };
+        auto exact = std::find_if(standbys.begin(), standbys.end(), [&](const standby& s) { return s.handle != 0 && s.launch.url == url; });
+        if (exact != standbys.end())
+            return take(exact, false);
+        auto any = std::find_if(standbys.begin(), standbys.end(), [&](const standby& s) { return s.handle != 0 && canNavigate(s); });
+        if (any != standbys.end())
+            return take(any, true);
+        return std::nullopt;
+    }
+
+    //The windows of every standby, so they aren't mistaken for anything else's
+    std::vector<windowHandle> handles() const
+    {
+        std::vector<windowHandle> result;
+        for (const auto& s : standbys)
+        {
+            if (s.handle != 0)
+                result.push_back(s.handle);
+        }
+        return result;
+    }
+};
@@ -0,0 +1,86 @@
+#pragma once
+#include <chrono>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+//Keeps track of when each ticking thing is next due, ordered by a min-heap so only due entries are ever looked at
+class tickScheduler
+{
+public:
+    using clock = std::chrono::steady_clock;
+    //Slot used for the global tick, everything else is identified by its index
+    static constexpr size_t globalSlot = std::numeric_limits<size_t>::max();
+
+private:
+    struct entry
+    {
+        clock::time_point due;
+        std::chrono::milliseconds interval;
+        size_t slot;
+
+        bool operator>(const entry& other) const { return due > other.due; }
+    };
+    std::priority_queue<entry, std::vector<entry>, std::greater<>> queue;
+
+public:
+    void clear()
+    {
+        queue = {};
+    }
+
+    //Schedules the slot to first run one interval from now, then every interval after that
+    void add(size_t slot, std::chrono::milliseconds interval)
+    {
+        //A zero interval would spin, so treat it as the smallest usable one
+        interval = std::max(interval, std::chrono::milliseconds(1));
+        queue.push({ clock::now() + interval, interval, slot });
+    }
+
+    //Schedules the slot to first run at the given time (e.g. when it was due before a reload), then every interval after that
+    void add(size_t slot, std::chrono::milliseconds interval, clock::time_point first)
+    {
+        interval = std::max(interval, std::chrono::milliseconds(1));
+        queue.push({ first, interval, slot });
+    }
+
+    //When each slot is next due, in no particular order
+    std::vector<std::pair<size_t, clock::time_point>> pending() const
+    {
+        std::vector<std::pair<size_t, clock::time_point>> result;
+        auto copy = queue;
+        while (!copy.empty())
+        {
+            result.emplace_back(copy.top().slot, copy.top().due);
+            copy.pop();
+        }
+        return result;
+    }
+
+    std::optional<clock::time_point> nextDue() const
+    {
+        if (queue.empty())
+            return std::nullopt;
+        return queue.top().due;
+    }
+
+    //Returns every slot that is due and schedules each again for its next interval
+    std::vector<size_t> takeDue(clock::time_point now = clock::now())
+    {
+        std::vector<size_t> due;
+        while (!queue.empty() && queue.top().due <= now)
+        {
+            auto e = queue.top();
+            queue.pop();
+            due.push_back(e.slot);
+            //Stay on the original cadence, but don't try to catch up on runs missed while we were busy
+            e.due += e.interval;
+            if (e.due <= now)
+                e.due = now + e.interval;
+            queue.push(e);
+        }
+        return due;
+    }
+};
@@ -0,0 +1,18 @@
+#pragma once
+#include <ctime>
+#include <string>
+
+//Replaces strftime codes (e.g. %Y-%m-%d_%H-%M-%S) in the path with the given time
+//Uses the C library's shared time buffer, so only the main thread may call this
+inline std::string expandTimeCodes(const std::string& path, std::time_t when)
+{
+    if (path.find('%') == std::string::npos)
+        return path;
+    std::string result(path.size() + 256, '\0');
+    const size_t length = std::strftime(result.data(), result.size(), path.c_str(), std::localtime(&when));
+    //strftime gives nothing back if the result didn't fit, or would be empty
+    if (length == 0)
+        return path;
+    result.resize(length);
+    return result;
+}
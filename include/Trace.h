@@ -0,0 +1,276 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "osmanip/manipulators/colsty.hpp"
+#include "Json.h"
+#include "WorkerPool.h"
+
+//Records when things started and finished (ticks, launches, moves, lua callbacks...), to be saved as a Chrome trace
+//The trace can be opened in chrome://tracing or Perfetto, to see where the time went on a timeline
+//Each thread records into a ring of its own without locking, so only the most recent events of each thread are kept
+class traceRecorder
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct event
+    {
+        //Microseconds since the recorder was created
+        std::int64_t time = 0;
+        //Expected to be a literal, so only the pointer is kept
+        const char* name = nullptr;
+        //'B' when the span began, 'E' when it ended, 'i' for a single moment
+        char phase = 'B';
+        //Copied in (and cut short if needed), so the event stays a fixed size
+        char detail[47] = {};
+    };
+
+private:
+    //Written only by its own thread, read when the trace is saved
+    struct ring
+    {
+        std::unique_ptr<event[]> events;
+        size_t capacity = 0;
+        //How many events have ever been written, the newest is at (written - 1) % capacity
+        std::atomic<std::uint64_t> written{ 0 };
+        std::string threadName;
+        int id = 0;
+    };
+
+    std::atomic<bool> enabled{ false };
+    std::atomic<size_t> capacity{ 0 };
+    //Only taken to add a thread's ring, or to read them all
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ring>> rings;
+    const clock::time_point origin = clock::now();
+
+    static inline thread_local ring* local = nullptr;
+    static inline thread_local const char* localName = nullptr;
+
+    traceRecorder() = default;
+
+    //The calling thread's ring, created the first time it records anything
+    //A ring keeps the size it was created with, even if TraceBufferSize changes later
+    ring& threadRing()
+    {
+        if (!local)
+        {
+            auto created = std::make_unique<ring>();
+            created->capacity = std::max<size_t>(capacity.load(std::memory_order_relaxed), 1);
+            created->events = std::make_unique<event[]>(created->capacity);
+            created->threadName = localName ? localName : "background";
+            std::lock_guard lock(mutex);
+            created->id = static_cast<int>(rings.size()) + 1;
+            local = created.get();
+            rings.push_back(std::move(created));
+        }
+        return *local;
+    }
+
+    //Cuts the text down to fit, without splitting a UTF-8 character
+    static void copyDetail(char (&out)[sizeof(event::detail)], std::string_view text)
+    {
+        size_t length = std::min(text.size(), sizeof(out) - 1);
+        if (length < text.size())
+        {
+            while (length > 0 && (static_cast<unsigned char>(text[length]) & 0xC0) == 0x80)
+                length--;
+        }
+        std::memcpy(out, text.data(), length);
+        out[length] = '\0';
+    }
+
+    struct threadEvents
+    {
+        std::string name;
+        int id = 0;
+        std::vector<event> events;
+    };
+
+    //Writes the events in the Chrome trace event format
+    static std::string render(const std::vector<threadEvents>& threads)
+    {
+        std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        auto add = [&](const std::string& entry)
+        {
+            if (!first)
+                out += ",\n";
+            first = false;
+            out += entry;
+        };
+        for (const auto& t : threads)
+        {
+            const auto tid = std::to_string(t.id);
+            add("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid + ",\"args\":{\"name\":" + jsonValue::quote(t.name) + "}}");
+            //The ring may have dropped the start of a span that is still in it, its end is dropped too
+            size_t depth = 0;
+            for (const auto& e : t.events)
+            {
+                if (e.phase == 'E')
+                {
+                    if (depth == 0)
+                        continue;
+                    depth--;
+                }
+                else if (e.phase == 'B')
+                {
+                    depth++;
+                }
+                std::string entry = "{\"name\":" + jsonValue::quote(e.name) + ",\"ph\":\"" + e.phase + "\",\"ts\":" + std::to_string(e.time) + ",\"pid\":1,\"tid\":" + tid;
+                if (e.detail[0] != '\0')
+                    entry += ",\"args\":{\"detail\":" + jsonValue::quote(e.detail) + "}";
+                add(entry + "}");
+            }
+        }
+        return out + "\n]}\n";
+    }
+
+public:
+    traceRecorder(const traceRecorder&) = delete;
+    traceRecorder& operator=(const traceRecorder&) = delete;
+
+    static traceRecorder& get()
+    {
+        static traceRecorder recorder;
+        return recorder;
+    }
+
+    //Names the calling thread in the trace, must be called before the thread records anything
+    static void nameThread(const char* name)
+    {
+        localName = name;
+    }
+
+    //Starts recording, keeping the given number of events per thread, or stops if it is 0
+    void configure(int bufferSize)
+    {
+        if (bufferSize > 0)
+            capacity.store(static_cast<size_t>(bufferSize), std::memory_order_relaxed);
+        enabled.store(bufferSize > 0, std::memory_order_relaxed);
+    }
+
+    bool isEnabled() const
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    //Records an event on the calling thread, returns false if tracing is off
+    bool record(const char* name, char phase, std::string_view detail = {})
+    {
+        if (!isEnabled())
+            return false;
+        auto& r = threadRing();
+        const auto index = r.written.load(std::memory_order_relaxed);
+        auto& e = r.events[index % r.capacity];
+        e.time = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - origin).count();
+        e.name = name;
+        e.phase = phase;
+        copyDetail(e.detail, detail);
+        //Publishes the event to whoever saves the trace
+        r.written.store(index + 1, std::memory_order_release);
+        return true;
+    }
+
+    //Records a moment on the calling thread, for things that happen rather than take time (e.g. a window appearing)
+    void mark(const char* name, std::string_view detail = {})
+    {
+        record(name, 'i', detail);
+    }
+
+    //Copies out what every thread has recorded, and saves it as a Chrome trace at the path in the background
+    //Recording carries on, so the trace can be saved again later
+    //Returns false if too many jobs are already waiting to be written
+    bool save(const std::string& path)
+    {
+        std::vector<threadEvents> threads;
+        {
+            std::lock_guard lock(mutex);
+            for (const auto& r : rings)
+            {
+                auto end = r->written.load(std::memory_order_acquire);
+                auto begin = end > r->capacity ? end - r->capacity : 0;
+                threadEvents copied{ r->threadName, r->id, {} };
+                copied.events.reserve(static_cast<size_t>(end - begin));
+                for (auto i = begin; i < end; ++i)
+                    copied.events.push_back(r->events[i % r->capacity]);
+                //Other threads carry on while we copy, anything they may have written over since is dropped
+                const auto now = r->written.load(std::memory_order_acquire);
+                if (now + 1 > begin + r->capacity)
+                {
+                    const auto overwritten = std::min<std::uint64_t>(now + 1 - r->capacity - begin, copied.events.size());
+                    copied.events.erase(copied.events.begin(), copied.events.begin() + static_cast<std::ptrdiff_t>(overwritten));
+                }
+                threads.push_back(std::move(copied));
+            }
+        }
+
+        bool queued = workerPool::get().post([threads = std::move(threads), path]()
+        {
+            const auto text = render(threads);
+            std::error_code error;
+            const std::filesystem::path target(path);
+            if (target.has_parent_path())
+                std::filesystem::create_directories(target.parent_path(), error);
+            auto temporary = target;
+            temporary += ".tmp";
+            {
+                std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+                file.write(text.data(), static_cast<std::streamsize>(text.size()));
+                if (!file)
+                {
+                    std::cout << osm::feat(osm::col, "red") << "Unable to save trace " << path << ": the file couldn't be written.\n" << osm::feat(osm::rst, "all");
+                    return;
+                }
+            }
+            std::filesystem::rename(temporary, target, error);
+            if (error)
+            {
+                std::filesystem::remove(temporary, error);
+                std::cout << osm::feat(osm::col, "red") << "Unable to save trace " << path << ": the file couldn't be renamed.\n" << osm::feat(osm::rst, "all");
+                return;
+            }
+            std::cout << "Saved trace to " << path << ".\n";
+        });
+        if (!queued)
+            std::cout << osm::feat(osm::col, "orange") << "Too many files are waiting to be written, skipping trace " << path << ".\n" << osm::feat(osm::rst, "all");
+        return queued;
+    }
+};
+
+//Records the span from its creation to its destruction in the trace, if tracing is on
+class traceSpan
+{
+    const char* name;
+    bool recorded;
+
+public:
+    //The name must outlive the span, it is expected to be a literal, the detail is copied
+    explicit traceSpan(const char* name, std::string_view detail = {}) : name(name), recorded(traceRecorder::get().record(name, 'B', detail)) {}
+    traceSpan(const traceSpan&) = delete;
+    traceSpan& operator=(const traceSpan&) = delete;
+    ~traceSpan()
+    {
+        if (recorded)
+            traceRecorder::get().record(name, 'E');
+    }
+};
+
+//Platform specific
+//Starts listening for the signal that saves the trace (SIGUSR1 on Linux), does nothing where there isn't one
+void listenForTraceSignal();
+//Returns a file descriptor that becomes readable once the signal has been received, or -1 if there isn't one
+int traceSignalSource();
+//Returns true (once) if the signal has been received since the last call
+bool takeTraceSignal();
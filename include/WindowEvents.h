@@ -0,0 +1,47 @@
+#pragma once
+#include "PlatformTypes.h"
+#include <algorithm>
+#include <vector>
+
+//Window changes reported by the window system since they were last collected
+struct windowEvents
+{
+    //Watched windows that were moved, resized, unmapped, destroyed or had their window state changed
+    std::vector<windowHandle> changed;
+    //Set when the window manager's list of client windows changed
+    bool clientListChanged = false;
+    //Set when monitors were added, removed or rearranged
+    bool monitorsChanged = false;
+
+    bool empty() const
+    {
+        return changed.empty() && !clientListChanged && !monitorsChanged;
+    }
+
+    //Adds another collection's events to these
+    void merge(const windowEvents& other)
+    {
+        for (auto window : other.changed)
+        {
+            if (std::find(changed.begin(), changed.end(), window) == changed.end())
+                changed.push_back(window);
+        }
+        clientListChanged |= other.clientListChanged;
+        monitorsChanged |= other.monitorsChanged;
+    }
+};
+
+//Subscribes to structure and state changes on the given window
+void watchWindow(windowHandle handle);
+
+//Returns a file descriptor that becomes readable when window events arrive, or -1 if there isn't one
+int windowEventSource();
+
+//Returns true if window events have already been queued (or deferred), in which case the event source will not report them
+bool windowEventsPending();
+
+//Drains all pending window events without blocking, including any that were deferred
+windowEvents collectWindowEvents();
+
+//Hands collected events back, so they are returned again by the next collection
+void deferWindowEvents(const windowEvents& events);
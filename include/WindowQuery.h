@@ -0,0 +1,23 @@
+#pragma once
+#include "PlatformTypes.h"
+#include "Rect.h"
+#include <span>
+#include <string>
+#include <vector>
+
+//The state of a window at the time it was queried
+struct windowState
+{
+    bool exists = false;
+    //Position on the desktop (not relative to any window manager frame) and size
+    rect bounds{ 0, 0, 0, 0 };
+    bool fullscreen = false;
+    //Whether the window is actually shown, rather than just created
+    bool mapped = false;
+    //The window's title (_NET_WM_NAME on Linux), which browsers change to the page's title once it has loaded
+    std::string title;
+};
+
+//Fetches the state of every given window together, costing a single round trip on Linux regardless of the window count
+//Windows that no longer exist (or a null handle) are reported with exists set to false
+std::vector<windowState> queryWindowStates(std::span<const windowHandle> windows);
@@ -0,0 +1,82 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//A few background threads for slow work that mustn't hold up the main loop (e.g. encoding and writing screenshots)
+//Jobs must not touch lua or the window system, and read settings through appSettings::snapshot()
+//Threads are started with the first job, and finish every queued job before the program exits
+class workerPool
+{
+    //Jobs beyond this are refused rather than queued, so a slow disk can't build up a backlog without end
+    static constexpr size_t maxQueued = 16;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> jobs;
+    std::vector<std::thread> threads;
+    bool stopping = false;
+
+    workerPool() = default;
+    ~workerPool()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads)
+            t.join();
+    }
+
+    void work()
+    {
+        while (true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock lock(mutex);
+                wake.wait(lock, [&]() { return stopping || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+public:
+    workerPool(const workerPool&) = delete;
+    workerPool& operator=(const workerPool&) = delete;
+
+    static workerPool& get()
+    {
+        static workerPool pool;
+        return pool;
+    }
+
+    //Queues the job for a background thread, returns false if too many jobs are already waiting
+    bool post(std::function<void()> job)
+    {
+        {
+            std::lock_guard lock(mutex);
+            if (jobs.size() >= maxQueued)
+                return false;
+            if (threads.empty())
+            {
+                //Half the cores at most, the kiosk and its browsers need the rest
+                const unsigned count = std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u);
+                for (unsigned i = 0; i < count; ++i)
+                    threads.emplace_back([this]() { work(); });
+            }
+            jobs.push_back(std::move(job));
+        }
+        wake.notify_one();
+        return true;
+    }
+};
@@ -0,0 +1,49 @@
+#include "EventLoop.h"
+#include <algorithm>
+
+//The timer bookkeeping is the same everywhere, only the wait in runOnce is platform specific
+
+eventLoop::timerId eventLoop::addTimer(std::chrono::milliseconds delay, handler onDue, std::chrono::milliseconds interval)
+{
+    timers.push_back({ ++lastTimer, std::chrono::steady_clock::now() + delay, interval, std::move(onDue) });
+    return lastTimer;
+}
+
+void eventLoop::removeTimer(timerId id)
+{
+    std::erase_if(timers, [&](const timer& t) { return t.id == id; });
+}
+
+std::optional<std::chrono::steady_clock::time_point> eventLoop::firstTimerDue() const
+{
+    auto first = std::min_element(timers.begin(), timers.end(), [](const timer& a, const timer& b) { return a.due < b.due; });
+    if (first == timers.end())
+        return std::nullopt;
+    return first->due;
+}
+
+void eventLoop::runDueTimers()
+{
+    //Handlers may add or remove timers, so pick out what is due first and look each one up again before running it
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<timerId> due;
+    for (const auto& t : timers)
+    {
+        if (t.due <= now)
+            due.push_back(t.id);
+    }
+
+    for (auto id : due)
+    {
+        auto it = std::find_if(timers.begin(), timers.end(), [&](const timer& t) { return t.id == id; });
+        if (it == timers.end())
+            continue;
+        auto onDue = it->onDue;
+        if (it->interval.count() > 0)
+            //If we fell behind, skip the missed runs rather than firing them all at once
+            it->due = std::max(it->due + it->interval, now);
+        else
+            timers.erase(it);
+        onDue();
+    }
+}
@@ -3,7 +3,20 @@
 #include <thread>
 #include <chrono>
 #include "StartupChecks.h"
+#include "WindowEvents.h"
+#include "FileWatch.h"
+#include "ChildSupervisor.h"
+#include "DevTools.h"
+#include "InputQueue.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "TimeCodes.h"
+#include "EventLoop.h"
+#include "LuaScheduler.h"
+#include "ConfigSnapshot.h"
 #include <iostream>
+#include <functional>
+#include <array>
 
 bool ansiEnabledPriorToExecution = false;
 
@@ -49,10 +62,24 @@ void disableAnsiSequences()
 	#endif
 }
 
+//Saves the trace at the path (strftime codes are replaced with the current time), returns false if there is no trace or it couldn't be queued
+bool saveTrace(const std::string& pathPattern)
+{
+	if (!traceRecorder::get().isEnabled())
+	{
+		std::cout << osm::feat(osm::col, "orange") << "No trace is being recorded, set TraceBufferSize to record one.\n" << osm::feat(osm::rst, "all");
+		return false;
+	}
+	return traceRecorder::get().save(expandTimeCodes(pathPattern, std::time(nullptr)));
+}
+
 //Clears any ansi state, existing processes and resets the terminal ansi status
 void cleanUp()
 {
 	std::cout << "Cleaning up.\n";
+	//Whatever led up to the exit is worth keeping
+	if (traceRecorder::get().isEnabled())
+		saveTrace(appSettings::get().traceFile);
 	closeAllExisting();
 	//Reset ansi sequence
 	std::cout << osm::feat(osm::rst, "all");
@@ -84,6 +111,52 @@ inline void luaPanic(sol::optional<std::string> msg)
 	std::cout << osm::feat(osm::rst, "all");
 }
 
+//Pauses the calling callback for the given number of milliseconds without holding up anything else
+//Outside of callbacks (e.g. while the script is loading) there is nothing to return to, so it has to block
+int luaSleep(lua_State* L)
+{
+	auto duration = std::chrono::milliseconds(luaL_checkinteger(L, 1));
+	if (!luaScheduler::runningOwner(L))
+	{
+		std::this_thread::sleep_for(duration);
+		return 0;
+	}
+	return luaScheduler::wait(L, {}, duration);
+}
+
+//Reads an optional timeout (in milliseconds) from the given argument
+std::optional<std::chrono::milliseconds> luaTimeout(lua_State* L, int index)
+{
+	if (lua_isnoneornil(L, index))
+		return std::nullopt;
+	return std::chrono::milliseconds(luaL_checkinteger(L, index));
+}
+
+//Waits until the calling callback's window is open and on its monitor (or every window, from the configuration's OnTick)
+//Returns true once it is, or false if the optional timeout passed first
+int luaWaitForWindow(lua_State* L)
+{
+	auto timeout = luaTimeout(L, 1);
+	auto who = luaScheduler::runningOwner(L);
+	auto scheduler = luaScheduler::current();
+	auto ready = [scheduler, who]() { return !scheduler->windowReady || scheduler->windowReady(*who); };
+	if (who && ready())
+	{
+		lua_pushboolean(L, 1);
+		return 1;
+	}
+	return luaScheduler::wait(L, ready, timeout);
+}
+
+//Waits until the given file next changes, returns true once it has, or false if the optional timeout passed first
+int luaWaitForFile(lua_State* L)
+{
+	auto file = fileWatchRegistry::get().watch(luaL_checkstring(L, 1));
+	auto timeout = luaTimeout(L, 2);
+	auto seenVersion = file->version;
+	return luaScheduler::wait(L, [file, seenVersion]() { return file->version != seenVersion; }, timeout);
+}
+
 int main()
 {
 	#ifdef _WIN32
@@ -95,6 +168,7 @@ int main()
 
 	enableAnsiSequences();
 	std::cout << osm::feat(osm::rst, "all");
+	traceRecorder::nameThread("main");
 
 	while (true)
 	{
@@ -104,17 +178,30 @@ int main()
 			{
 				throw std::runtime_error("Unable to find Kiosk.lua");
 			}
-			std::filesystem::file_time_type lastLoadTime = std::filesystem::last_write_time("Kiosk.lua");
+			auto& files = fileWatchRegistry::get();
+			auto configFile = files.watch("Kiosk.lua");
+			size_t loadedVersion = configFile->version;
 
 			processManager manager;
 
 			sol::state lua(sol::c_call<decltype(&luaPanic), &luaPanic>);
 			lua.open_libraries(sol::lib::base, sol::lib::package, sol::lib::string, sol::lib::table);
+			//Snapshots refer to functions in the lua state, so they must be gone before it is
+			configStoreScope configScope;
 			process::initialiseLUAState(lua);
+			//Declared after the lua state, as waiting callbacks must be gone before it is
+			luaScheduler scheduler(lua);
+			scheduler.windowReady = [&](luaScheduler::owner who) { return manager.windowReady(who); };
 
 			lua.set_function("SynchroniseTicks", &processManager::synchroniseTicks, std::ref(manager));
 			lua.set_function("StateHasChanged", [&]() { manager.needsRefresh = true; });
-			lua.set_function("Sleep", [](unsigned int ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); });
+			lua.set_function("Sleep", &luaSleep);
+			lua.set_function("WaitForWindow", &luaWaitForWindow);
+			lua.set_function("WaitForFile", &luaWaitForFile);
+			lua.set_function("GetProfile", [&](sol::this_state L) { return scheduler.profileTable(L); });
+			lua.set_function("PrintProfile", [&]() { scheduler.logProfile(); });
+			lua.set_function("ResetProfile", [&]() { scheduler.resetProfiles(); });
+			lua.set_function("SaveTrace", [](sol::optional<std::string> path) { return saveTrace(path.value_or(appSettings::get().traceFile)); });
 
 			auto luaOutput = lua.safe_script_file("Kiosk.lua");
 
@@ -125,44 +212,176 @@ int main()
 				std::cout << osm::feat(osm::col, "red") << "Loading lua failed: " << what << '\n' << osm::feat(osm::rst, "all");
 			}
 
-			appSettings::get().loadFromTable(lua);
+			//Reads the settings and windows out of the lua state once, everything else works from the compiled snapshot
+			auto compileConfig = [&]()
+			{
+				configStore::get().publish(configSnapshot::compile(lua, appSettings::get()));
+				metricsServer::get().configure(appSettings::get().metricsSocket, appSettings::get().metricsPort);
+				traceRecorder::get().configure(appSettings::get().traceBufferSize);
+				if (appSettings::get().traceBufferSize > 0)
+					listenForTraceSignal();
+			};
+			compileConfig();
 
-			if (!runStartupChecks())
+			bool checksPassed = false;
+			{
+				traceSpan span("startup checks");
+				checksPassed = runStartupChecks();
+			}
+			if (!checksPassed)
 			{
 				std::cout << "Startup checks failed, fix the above issues and restart.\n";
 				break;
 			}
 
 			if (appSettings::get().closeAllOnStart)
+			{
+				traceSpan span("close all");
 				closeAllExisting();
+			}
+
+			{
+				traceSpan span("apply configuration");
+				manager.apply(*configStore::get().current());
+			}
 
-			manager.loadFromTable(lua, appSettings::get().configuration);
 
+			eventLoop loop;
 
-			while (true)
+			//Runs the watches of any files that changed, then comes back once any pending changes have settled
+			eventLoop::timerId settleTimer = 0;
+			std::function<void()> onFilesChanged = [&]()
+			{
+				if (files.update())
+					manager.checkWatches();
+				loop.removeTimer(settleTimer);
+				if (auto settle = files.nextDeadline())
+					settleTimer = loop.addTimer(std::chrono::ceil<std::chrono::milliseconds>(*settle - std::chrono::steady_clock::now()), onFilesChanged);
+			};
+
+			auto onWindowsChanged = [&]()
+			{
+				//Always drain the events, even if we aren't acting on them, so they don't build up
+				auto windowChanges = collectWindowEvents();
+				//Hotplugs are acted on regardless, as every window may need to move
+				if (windowChanges.monitorsChanged)
+					manager.onMonitorsChanged();
+				//New windows may be standbys that have finished starting
+				if (windowChanges.clientListChanged)
+					manager.updateStandby();
+				if (appSettings::get().eventDriven)
+					manager.onWindowEvents(windowChanges);
+			};
+
+			//Restart anything that crashed straight away
+			auto onChildrenExited = [&]()
 			{
-				std::this_thread::sleep_for(std::chrono::seconds(appSettings::get().refreshTime));
+				manager.onProcessesExited(childSupervisor::get().collectExited());
+			};
 
+			auto onTick = [&]()
+			{
 				manager.tick();
+				//Covers platforms (and files) without change notifications
+				onFilesChanged();
+				onChildrenExited();
+				//Also sends anything a busy browser wasn't ready for earlier
+				devTools::get().update();
+				//Drops connections that never sent a request
+				metricsServer::get().update();
+			};
+			//Each window ticks on its own schedule, so the timer is re-armed for whichever is due next
+			std::optional<eventLoop::timerId> tickTimer;
+			auto armTick = [&]()
+			{
+				if (tickTimer)
+					loop.removeTimer(*tickTimer);
+				tickTimer.reset();
+				if (auto due = manager.nextDue())
+					tickTimer = loop.addTimer(std::chrono::ceil<std::chrono::milliseconds>(*due - std::chrono::steady_clock::now()), onTick);
+			};
+
+			//Wakes up for the next sleeping callback, other waits are checked after every pass anyway
+			std::optional<eventLoop::timerId> taskTimer;
+			auto armTasks = [&]()
+			{
+				if (taskTimer)
+					loop.removeTimer(*taskTimer);
+				taskTimer.reset();
+				if (auto due = scheduler.nextDue())
+					taskTimer = loop.addTimer(std::chrono::ceil<std::chrono::milliseconds>(*due - std::chrono::steady_clock::now()), [&]() { scheduler.resumeReady(); });
+			};
+
+			//Wakes up for the next keypress or click due to be sent
+			std::optional<eventLoop::timerId> inputTimer;
+			auto armInput = [&]()
+			{
+				if (inputTimer)
+					loop.removeTimer(*inputTimer);
+				inputTimer.reset();
+				if (auto due = inputQueue::get().nextDue())
+					inputTimer = loop.addTimer(std::chrono::ceil<std::chrono::milliseconds>(*due - std::chrono::steady_clock::now()), []() { inputQueue::get().update(); });
+			};
+
+			//Sources are created lazily and can be replaced (e.g. on reconnecting to X, often reusing the same number), so they are registered again before every wait
+			std::array<int, 6> registered{ -1, -1, -1, -1, -1, -1 };
+			auto syncSource = [&](int& current, int fd, eventLoop::handler onReady, eventLoop::pendingCheck pending = {})
+			{
+				if (current != fd)
+					loop.unwatch(current);
+				current = fd;
+				loop.watch(fd, std::move(onReady), std::move(pending));
+			};
+
+			while (true)
+			{
+				syncSource(registered[0], windowEventSource(), onWindowsChanged, &windowEventsPending);
+				syncSource(registered[1], files.eventSource(), onFilesChanged);
+				syncSource(registered[2], childSupervisor::get().eventSource(), onChildrenExited);
+				syncSource(registered[3], devTools::get().eventSource(), []() { devTools::get().update(); });
+				syncSource(registered[4], metricsServer::get().eventSource(), []() { metricsServer::get().update(); });
+				syncSource(registered[5], traceSignalSource(), []()
+				{
+					if (takeTraceSignal())
+						saveTrace(appSettings::get().traceFile);
+				});
+				armTick();
+				armTasks();
+				armInput();
+
+				//Sleeps until something happens, there is no fixed polling interval
+				loop.runOnce();
+
+				//Whatever happened may have been a page finishing loading
+				manager.checkReadiness();
+				//Placement steps that weren't confirmed in time are sent again
+				manager.checkPlacements();
+				manager.checkPlaylists();
 
 				if (manager.needsRefresh)
 				{
 					//Refresh the state without reloading the file
-					appSettings::get().loadFromTable(lua);
-					manager.loadFromTable(lua, appSettings::get().configuration);
+					auto timer = timeReload();
+					traceSpan span("refresh");
+					compileConfig();
+					manager.apply(*configStore::get().current());
 					manager.needsRefresh = false;
 				}
 
 				//Check whether the kiosk.lua file has been modified
-				auto lastWriteTime = std::filesystem::last_write_time("Kiosk.lua");
-				if (lastWriteTime > lastLoadTime)
+				if (configFile->version != loadedVersion)
 				{
-					lastLoadTime = lastWriteTime;
+					loadedVersion = configFile->version;
 					std::cout << osm::feat(osm::col, "orange") << "Reloading...\n" << osm::feat(osm::rst, "all");
+					auto timer = timeReload();
+					traceSpan span("reload");
 					lua.script_file("Kiosk.lua");
-					appSettings::get().loadFromTable(lua);
-					manager.loadFromTable(lua, appSettings::get().configuration);
+					compileConfig();
+					manager.apply(*configStore::get().current());
 				}
+
+				//Whatever happened may be what a callback was waiting for
+				scheduler.resumeReady();
 			}
 		}
 		catch (std::exception& ex)
@@ -0,0 +1,100 @@
+#ifdef __linux__
+#include "ChildSupervisor.h"
+#include <algorithm>
+#include <iostream>
+#include <utility>
+#include <cerrno>
+#include <csignal>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "osmanip/manipulators/colsty.hpp"
+
+childSupervisor::~childSupervisor()
+{
+    for (auto& c : children)
+    {
+        if (c.pidfd != -1)
+            ::close(c.pidfd);
+    }
+    if (source != -1)
+        ::close(source);
+}
+
+childSupervisor& childSupervisor::get()
+{
+    static childSupervisor supervisor;
+    return supervisor;
+}
+
+void childSupervisor::track(processId pid)
+{
+    if (pid <= 0)
+        return;
+    child c{ pid, static_cast<int>(syscall(SYS_pidfd_open, pid, 0)) };
+    if (c.pidfd != -1)
+    {
+        if (source == -1)
+            source = epoll_create1(EPOLL_CLOEXEC);
+        //A pidfd becomes readable once the process exits
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = c.pidfd;
+        if (source == -1 || epoll_ctl(source, EPOLL_CTL_ADD, c.pidfd, &event) == -1)
+        {
+            ::close(c.pidfd);
+            c.pidfd = -1;
+        }
+    }
+    children.push_back(c);
+}
+
+void childSupervisor::reap()
+{
+    std::erase_if(children, [&](child& c)
+    {
+        int status = 0;
+        pid_t result = waitpid(c.pid, &status, WNOHANG);
+        //ECHILD means someone else already reaped it, either way it's gone
+        if (result == 0 || (result == -1 && errno != ECHILD))
+            return false;
+
+        if (result == c.pid && WIFSIGNALED(status) && WTERMSIG(status) != SIGTERM && WTERMSIG(status) != SIGKILL)
+        {
+            std::cout << osm::feat(osm::col, "orange") << "Process " << c.pid << " was terminated by signal " << WTERMSIG(status) << ".\n" << osm::feat(osm::rst, "all");
+        }
+        //Closing the pidfd also removes it from the epoll set
+        if (c.pidfd != -1)
+            ::close(c.pidfd);
+        exited.push_back(c.pid);
+        return true;
+    });
+}
+
+std::vector<processId> childSupervisor::collectExited()
+{
+    reap();
+    return std::exchange(exited, {});
+}
+
+bool childSupervisor::running(processId pid)
+{
+    reap();
+    return std::any_of(children.begin(), children.end(), [&](const child& c) { return c.pid == pid; });
+}
+
+void childSupervisor::signal(processId pid, int sig)
+{
+    if (pid <= 0)
+        return;
+    auto it = std::find_if(children.begin(), children.end(), [&](const child& c) { return c.pid == pid; });
+    if (it != children.end() && it->pidfd != -1)
+    {
+        syscall(SYS_pidfd_send_signal, it->pidfd, sig, nullptr, 0);
+        return;
+    }
+    //Not one of ours (or no pidfd support), all we have is the pid
+    kill(pid, sig);
+}
+#endif
@@ -0,0 +1,119 @@
+#ifdef __linux__
+#include "DevTools.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+devToolsChannel::~devToolsChannel()
+{
+    if (toBrowser != -1)
+        ::close(toBrowser);
+    if (fromBrowser != -1)
+        ::close(fromBrowser);
+}
+
+bool devToolsChannel::flush()
+{
+    while (!outgoing.empty())
+    {
+        ssize_t written = ::write(toBrowser, outgoing.data(), outgoing.size());
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            //The rest goes once the browser has caught up, on the next update
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        outgoing.erase(0, static_cast<size_t>(written));
+    }
+    return true;
+}
+
+bool devToolsChannel::receive()
+{
+    char buffer[16384];
+    while (true)
+    {
+        ssize_t count = ::read(fromBrowser, buffer, sizeof(buffer));
+        if (count > 0)
+        {
+            incoming.append(buffer, static_cast<size_t>(count));
+            continue;
+        }
+        if (count == 0)
+            return false;
+        if (errno == EINTR)
+            continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+devTools::~devTools()
+{
+    channels.clear();
+    if (source != -1)
+        ::close(source);
+}
+
+devTools& devTools::get()
+{
+    static devTools registry;
+    return registry;
+}
+
+std::optional<devToolsPipe> devTools::createPipe()
+{
+    //Writing to a browser that has just exited would otherwise kill us, the failed write is handled instead
+    static const bool ignoringBrokenPipes = (std::signal(SIGPIPE, SIG_IGN), true);
+    (void)ignoringBrokenPipes;
+    int commands[2];
+    int messages[2];
+    if (pipe2(commands, O_CLOEXEC) == -1)
+        return std::nullopt;
+    if (pipe2(messages, O_CLOEXEC) == -1)
+    {
+        ::close(commands[0]);
+        ::close(commands[1]);
+        return std::nullopt;
+    }
+    //Only our ends are non-blocking, the browser expects ordinary pipes
+    fcntl(commands[1], F_SETFL, fcntl(commands[1], F_GETFL) | O_NONBLOCK);
+    fcntl(messages[0], F_SETFL, fcntl(messages[0], F_GETFL) | O_NONBLOCK);
+    return devToolsPipe{ commands[0], commands[1], messages[0], messages[1] };
+}
+
+void devTools::open(processId pid, const devToolsPipe& pipe)
+{
+    //The browser has its own copies of these now
+    ::close(pipe.commandsRead);
+    ::close(pipe.messagesWrite);
+    if (pid <= 0)
+    {
+        ::close(pipe.commandsWrite);
+        ::close(pipe.messagesRead);
+        return;
+    }
+
+    //A reused pid means the old browser is long gone
+    std::erase_if(channels, [&](const auto& c) { return c.first == pid; });
+
+    if (source == -1)
+        source = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = pipe.messagesRead;
+    if (source != -1)
+        epoll_ctl(source, EPOLL_CTL_ADD, pipe.messagesRead, &event);
+    channels.emplace_back(pid, std::make_unique<devToolsChannel>(pipe.commandsWrite, pipe.messagesRead));
+}
+
+void devTools::update()
+{
+    //Every channel is read until it would block, which clears the group's readiness too
+    //Closing a channel's descriptor also removes it from the epoll set
+    std::erase_if(channels, [](auto& c) { return !c.second->update(); });
+}
+#endif
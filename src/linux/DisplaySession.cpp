@@ -0,0 +1,92 @@
+#ifdef __linux__
+#include "DisplaySession.h"
+#include <iostream>
+#include "osmanip/manipulators/colsty.hpp"
+
+//Window operations routinely race against windows closing, so BadWindow and friends are expected and ignored
+static int ignoreErrors(Display*, XErrorEvent*)
+{
+    return 0;
+}
+
+//The default handler prints a diagnostic, the connection loss itself is handled by onConnectionLost
+static int ignoreIOErrors(Display*)
+{
+    return 0;
+}
+
+displaySession::~displaySession()
+{
+    disconnect();
+}
+
+displaySession& displaySession::get()
+{
+    static displaySession session;
+    return session;
+}
+
+void displaySession::onConnectionLost(Display*, void* userData)
+{
+    //Returning here (rather than exiting, which Xlib does by default) leaves the display unusable but lets us reconnect
+    static_cast<displaySession*>(userData)->lost = true;
+}
+
+void displaySession::connect()
+{
+    XSetErrorHandler(ignoreErrors);
+    XSetIOErrorHandler(ignoreIOErrors);
+    display = XOpenDisplay(nullptr);
+    if (!display)
+        return;
+    XSetIOErrorExitHandler(display, &displaySession::onConnectionLost, this);
+    lost = false;
+    generation++;
+}
+
+void displaySession::disconnect()
+{
+    atoms.clear();
+    if (display)
+    {
+        XCloseDisplay(display);
+        display = nullptr;
+    }
+}
+
+Display* displaySession::handle()
+{
+    if (display && lost)
+    {
+        std::cout << osm::feat(osm::col, "orange") << "Lost connection to the X server, reconnecting.\n" << osm::feat(osm::rst, "all");
+        disconnect();
+    }
+    if (!display)
+        connect();
+    return display;
+}
+
+Atom displaySession::atom(const std::string& name, bool onlyIfExists)
+{
+    Display* dpy = handle();
+    if (!dpy)
+        return None;
+
+    if (auto it = atoms.find(name); it != atoms.end())
+        return it->second;
+
+    Atom result = XInternAtom(dpy, name.c_str(), onlyIfExists ? True : False);
+    //An atom that doesn't exist yet may be created later by another client, so only cache real atoms
+    if (result != None)
+        atoms.emplace(name, result);
+    return result;
+}
+
+Window displaySession::root()
+{
+    Display* dpy = handle();
+    if (!dpy)
+        return None;
+    return DefaultRootWindow(dpy);
+}
+#endif
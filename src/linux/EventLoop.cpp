@@ -0,0 +1,103 @@
+#ifdef __linux__
+#include "EventLoop.h"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+eventLoop::eventLoop()
+{
+    source = epoll_create1(EPOLL_CLOEXEC);
+    timerSource = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (source == -1 || timerSource == -1)
+        throw std::runtime_error("Failed to create the event loop");
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = timerSource;
+    epoll_ctl(source, EPOLL_CTL_ADD, timerSource, &event);
+}
+
+eventLoop::~eventLoop()
+{
+    if (timerSource != -1)
+        ::close(timerSource);
+    if (source != -1)
+        ::close(source);
+}
+
+void eventLoop::watch(int fd, handler onReady, pendingCheck pending)
+{
+    if (fd == -1)
+        return;
+    watchers[fd] = { std::move(onReady), std::move(pending) };
+    //The kernel forgets a descriptor once it is closed, even if a new one gets the same number, so always try adding it
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(source, EPOLL_CTL_ADD, fd, &event) == -1 && errno == EEXIST)
+        epoll_ctl(source, EPOLL_CTL_MOD, fd, &event);
+}
+
+void eventLoop::unwatch(int fd)
+{
+    if (watchers.erase(fd) > 0)
+        epoll_ctl(source, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void eventLoop::runOnce(std::chrono::milliseconds timeout)
+{
+    //Work a source has already queued won't wake epoll, so don't wait if there is any
+    bool pendingWork = std::any_of(watchers.begin(), watchers.end(), [](const auto& w) { return w.second.pending && w.second.pending(); });
+
+    //Arm the timer descriptor for whichever timer is due first
+    itimerspec deadline{};
+    if (auto first = firstTimerDue())
+    {
+        //steady_clock is CLOCK_MONOTONIC on Linux, so the deadline can be given directly
+        auto since = std::chrono::duration_cast<std::chrono::nanoseconds>(first->time_since_epoch()).count();
+        deadline.it_value.tv_sec = since / 1'000'000'000;
+        deadline.it_value.tv_nsec = since % 1'000'000'000;
+        //An all zero value disarms the timer, so nudge a deadline at the epoch
+        if (since <= 0)
+            deadline.it_value.tv_nsec = 1;
+    }
+    timerfd_settime(timerSource, TFD_TIMER_ABSTIME, &deadline, nullptr);
+
+    std::array<epoll_event, 16> events;
+    int count = epoll_wait(source, events.data(), static_cast<int>(events.size()), pendingWork ? 0 : static_cast<int>(timeout.count()));
+
+    std::vector<int> ready;
+    for (int i = 0; i < count; ++i)
+    {
+        int fd = events[i].data.fd;
+        if (fd == timerSource)
+        {
+            uint64_t expirations;
+            [[maybe_unused]] auto ignored = read(timerSource, &expirations, sizeof(expirations));
+            continue;
+        }
+        ready.push_back(fd);
+    }
+    for (const auto& [fd, w] : watchers)
+    {
+        if (w.pending && std::find(ready.begin(), ready.end(), fd) == ready.end() && w.pending())
+            ready.push_back(fd);
+    }
+
+    for (int fd : ready)
+    {
+        //Copied, as the handler may replace or remove itself
+        auto it = watchers.find(fd);
+        if (it == watchers.end())
+            continue;
+        auto onReady = it->second.onReady;
+        onReady();
+    }
+
+    runDueTimers();
+}
+#endif
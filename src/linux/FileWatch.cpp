@@ -0,0 +1,163 @@
+#ifdef __linux__
+#include "FileWatch.h"
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <algorithm>
+
+//Closing a file after writing covers in-place saves, moving a file in covers editors that save via a temporary file
+static constexpr uint32_t watchMask = IN_CLOSE_WRITE | IN_MOVED_TO;
+
+fileWatchRegistry::~fileWatchRegistry()
+{
+    if (source != -1)
+        ::close(source);
+}
+
+fileWatchRegistry& fileWatchRegistry::get()
+{
+    static fileWatchRegistry registry;
+    return registry;
+}
+
+bool fileWatchRegistry::refresh(watchedFile& file)
+{
+    std::error_code ec;
+    auto newTime = std::filesystem::last_write_time(file.path, ec);
+    if (ec || newTime == file.lastWrite)
+        return false;
+    file.lastWrite = newTime;
+    file.version++;
+    return true;
+}
+
+void fileWatchRegistry::watchDirectory(watchedFile& file)
+{
+    if (source == -1)
+    {
+        source = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (source == -1)
+            return;
+    }
+    //Watching the directory rather than the file means we survive the file being replaced
+    auto directory = file.path.parent_path();
+    int wd = inotify_add_watch(source, directory.c_str(), watchMask);
+    if (wd == -1)
+        return;
+    directories[wd] = directory;
+    file.directoryWatch = wd;
+}
+
+std::shared_ptr<const watchedFile> fileWatchRegistry::watch(const std::filesystem::path& path)
+{
+    auto absolute = std::filesystem::absolute(path).lexically_normal();
+    for (auto& weak : files)
+    {
+        if (auto existing = weak.lock(); existing && existing->path == absolute)
+            return existing;
+    }
+
+    auto file = std::make_shared<watchedFile>();
+    file->path = absolute;
+    std::error_code ec;
+    if (auto time = std::filesystem::last_write_time(absolute, ec); !ec)
+        file->lastWrite = time;
+    watchDirectory(*file);
+    files.push_back(file);
+    return file;
+}
+
+std::optional<std::chrono::steady_clock::time_point> fileWatchRegistry::nextDeadline() const
+{
+    std::optional<std::chrono::steady_clock::time_point> result;
+    for (auto& weak : files)
+    {
+        auto file = weak.lock();
+        if (file && file->pendingSince)
+        {
+            auto deadline = *file->pendingSince + settleTime;
+            if (!result || deadline < *result)
+                result = deadline;
+        }
+    }
+    return result;
+}
+
+bool fileWatchRegistry::update()
+{
+    //Forget files nobody is watching any more,
+    std::erase_if(files, [](const std::weak_ptr<watchedFile>& weak) { return weak.expired(); });
+    //and stop watching directories none of the remaining files are in, so watches don't pile up across reloads
+    for (auto it = directories.begin(); it != directories.end();)
+    {
+        const int wd = it->first;
+        const bool used = std::any_of(files.begin(), files.end(), [&](const std::weak_ptr<watchedFile>& weak)
+        {
+            auto file = weak.lock();
+            return file && file->directoryWatch == wd;
+        });
+        if (used)
+        {
+            ++it;
+            continue;
+        }
+        inotify_rm_watch(source, wd);
+        it = directories.erase(it);
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (source != -1)
+    {
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(source, buffer, sizeof(buffer))) > 0)
+        {
+            for (char* ptr = buffer; ptr < buffer + length; ptr += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(ptr)->len)
+            {
+                auto* event = reinterpret_cast<inotify_event*>(ptr);
+                if (event->mask & IN_IGNORED)
+                {
+                    //The directory went away, fall back to checking its files directly until it returns
+                    directories.erase(event->wd);
+                    for (auto& weak : files)
+                    {
+                        if (auto file = weak.lock(); file && file->directoryWatch == event->wd)
+                            file->directoryWatch = -1;
+                    }
+                    continue;
+                }
+                if (event->len == 0)
+                    continue;
+                auto it = directories.find(event->wd);
+                if (it == directories.end())
+                    continue;
+                auto changed = it->second / event->name;
+                for (auto& weak : files)
+                {
+                    if (auto file = weak.lock(); file && file->path == changed)
+                        file->pendingSince = now;
+                }
+            }
+        }
+    }
+
+    bool changed = false;
+    for (auto& weak : files)
+    {
+        auto file = weak.lock();
+        if (!file)
+            continue;
+        if (file->directoryWatch == -1)
+        {
+            //Without a directory watch we have to look for ourselves, and keep trying to get one
+            changed |= refresh(*file);
+            watchDirectory(*file);
+        }
+        else if (file->pendingSince && now - *file->pendingSince >= settleTime)
+        {
+            file->pendingSince.reset();
+            changed |= refresh(*file);
+        }
+    }
+    return changed;
+}
+#endif
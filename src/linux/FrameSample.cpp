@@ -0,0 +1,135 @@
+#ifdef __linux__
+#include "FrameSample.h"
+#include "DisplaySession.h"
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include "osmanip/manipulators/colsty.hpp"
+#include <iostream>
+
+//Shared memory the X server copies frames into, so frames never travel over the connection itself
+//Kept between samples and only replaced when a larger area is sampled, or the connection changes
+struct sharedFrameMemory
+{
+    size_t generation = 0;
+    XShmSegmentInfo info{};
+    size_t size = 0;
+    bool attached = false;
+
+    void release(Display* display)
+    {
+        //The segment is only attached to the connection it was made for
+        if (attached && display && generation == displaySession::get().getGeneration())
+            XShmDetach(display, &info);
+        if (info.shmaddr && info.shmaddr != reinterpret_cast<char*>(-1))
+            shmdt(info.shmaddr);
+        *this = {};
+    }
+
+    bool reserve(Display* display, size_t needed)
+    {
+        if (attached && generation == displaySession::get().getGeneration() && size >= needed)
+            return true;
+        release(display);
+
+        info.shmid = shmget(IPC_PRIVATE, needed, IPC_CREAT | 0600);
+        if (info.shmid == -1)
+            return false;
+        info.shmaddr = static_cast<char*>(shmat(info.shmid, nullptr, 0));
+        info.readOnly = False;
+        const bool mapped = info.shmaddr != reinterpret_cast<char*>(-1);
+        if (mapped && XShmAttach(display, &info))
+        {
+            //The server must have attached before the segment is marked for removal
+            XSync(display, False);
+            attached = true;
+        }
+        //Removed once both sides have detached, so nothing is left behind if we exit
+        shmctl(info.shmid, IPC_RMID, nullptr);
+        if (!attached)
+        {
+            release(display);
+            return false;
+        }
+        generation = displaySession::get().getGeneration();
+        size = needed;
+        return true;
+    }
+};
+
+//Reads each area of the screen into shared memory, and gives the pixels to the reader while they are still there
+//Areas that can't be read are skipped, and the reader is told nothing of them
+template <typename Reader>
+static void readAreas(std::span<const rect> areas, Reader&& reader)
+{
+    auto& session = displaySession::get();
+    Display* display = session.handle();
+    if (!display)
+        return;
+
+    if (!XShmQueryExtension(display))
+    {
+        static bool warned = false;
+        if (!warned)
+            std::cout << osm::feat(osm::col, "orange") << "The X server doesn't support MIT-SHM, windows can't be sampled or captured.\n" << osm::feat(osm::rst, "all");
+        warned = true;
+        return;
+    }
+
+    static sharedFrameMemory memory;
+    const int screen = DefaultScreen(display);
+    Visual* visual = DefaultVisual(display, screen);
+    const unsigned depth = static_cast<unsigned>(DefaultDepth(display, screen));
+    const int screenWidth = DisplayWidth(display, screen);
+    const int screenHeight = DisplayHeight(display, screen);
+
+    for (size_t i = 0; i < areas.size(); ++i)
+    {
+        //Areas are read from the root window, which must be asked for nothing outside the screen
+        const int left = std::max(areas[i].left, 0);
+        const int top = std::max(areas[i].top, 0);
+        const int width = std::min(areas[i].left + areas[i].width, screenWidth) - left;
+        const int height = std::min(areas[i].top + areas[i].height, screenHeight) - top;
+        if (width <= 0 || height <= 0)
+            continue;
+
+        XImage* image = XShmCreateImage(display, visual, depth, ZPixmap, nullptr, &memory.info, static_cast<unsigned>(width), static_cast<unsigned>(height));
+        if (!image)
+            continue;
+        const size_t needed = static_cast<size_t>(image->bytes_per_line) * static_cast<size_t>(height);
+        //Only the usual little endian BGRX layout is understood
+        const bool bgrx = image->bits_per_pixel == 32 && image->byte_order == LSBFirst && image->red_mask == 0xFF0000 && image->blue_mask == 0xFF;
+        if (bgrx && memory.reserve(display, needed))
+        {
+            image->data = memory.info.shmaddr;
+            if (XShmGetImage(display, session.root(), image, left, top, AllPlanes))
+                reader(i, reinterpret_cast<const std::uint8_t*>(image->data), width, height, static_cast<std::ptrdiff_t>(image->bytes_per_line));
+        }
+        //The data and segment info belong to the shared memory, not the image
+        image->data = nullptr;
+        image->obdata = nullptr;
+        XDestroyImage(image);
+    }
+}
+
+std::vector<std::optional<frameSample>> sampleFrames(std::span<const rect> areas)
+{
+    std::vector<std::optional<frameSample>> result(areas.size());
+    readAreas(areas, [&](size_t i, const std::uint8_t* pixels, int width, int height, std::ptrdiff_t stride)
+    {
+        result[i] = summariseFrame(pixels, width, height, stride);
+    });
+    return result;
+}
+
+std::optional<capturedFrame> captureArea(rect area)
+{
+    std::optional<capturedFrame> result;
+    readAreas({ &area, 1 }, [&](size_t, const std::uint8_t* pixels, int width, int height, std::ptrdiff_t stride)
+    {
+        result = capturedFrame::copy(pixels, width, height, stride);
+    });
+    return result;
+}
+#endif
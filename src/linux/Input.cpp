@@ -0,0 +1,234 @@
+#ifdef __linux__
+#include "InputQueue.h"
+#include "DisplaySession.h"
+#include <chrono>
+#include <optional>
+#include <vector>
+#include <X11/XKBlib.h>
+#include <X11/extensions/XTest.h>
+#include <X11/keysym.h>
+
+//How long a window is given to turn a spare key's press into a character before the key may be bound to another
+//The queue holds back a character that has to wait for at least this long (its retryDelay)
+static constexpr auto spareHandleTime = std::chrono::milliseconds(50);
+
+//Keys with nothing bound to them, borrowed to type characters the keyboard layout doesn't have
+//Only valid for the connection they were found on
+struct spareKeys
+{
+    size_t generation = 0;
+    bool found = false;
+    int symsPerCode = 0;
+    std::vector<KeyCode> codes;
+    //What each spare is currently bound to, NoSymbol if nothing
+    std::vector<KeySym> bound;
+    //When each spare was last pressed, it can't be rebound until the window has had time to handle the press
+    std::vector<std::chrono::steady_clock::time_point> pressed;
+    size_t nextToUse = 0;
+};
+
+static spareKeys& getSpareKeys(Display* display)
+{
+    static spareKeys spares;
+    auto& session = displaySession::get();
+    if (spares.found && spares.generation == session.getGeneration())
+        return spares;
+
+    spares = {};
+    spares.generation = session.getGeneration();
+    spares.found = true;
+    int minCode = 0;
+    int maxCode = 0;
+    XDisplayKeycodes(display, &minCode, &maxCode);
+    KeySym* mapping = XGetKeyboardMapping(display, static_cast<KeyCode>(minCode), maxCode - minCode + 1, &spares.symsPerCode);
+    if (!mapping)
+        return spares;
+    //Taken from the top, where layouts leave gaps
+    for (int code = maxCode; code >= minCode && spares.codes.size() < 8; --code)
+    {
+        const KeySym* syms = mapping + static_cast<size_t>(code - minCode) * spares.symsPerCode;
+        bool unused = true;
+        for (int i = 0; i < spares.symsPerCode; ++i)
+            unused = unused && syms[i] == NoSymbol;
+        if (unused)
+            spares.codes.push_back(static_cast<KeyCode>(code));
+    }
+    XFree(mapping);
+    spares.bound.assign(spares.codes.size(), NoSymbol);
+    spares.pressed.assign(spares.codes.size(), {});
+    return spares;
+}
+
+//Binds a spare key to the symbol and marks it pressed, returns nothing if there are no spare keys
+//Returns 0 if every spare was pressed too recently to be rebound, in which case the character has to wait
+static std::optional<KeyCode> bindSpareKey(Display* display, KeySym sym)
+{
+    auto& spares = getSpareKeys(display);
+    if (spares.codes.empty())
+        return std::nullopt;
+    const auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < spares.codes.size(); ++i)
+    {
+        if (spares.bound[i] == sym)
+        {
+            spares.pressed[i] = now;
+            return spares.codes[i];
+        }
+    }
+    //The oldest binding is replaced, unless it was pressed so recently the window may not have handled it yet
+    //(e.g. earlier in the same flush), the window would then read that press with the new binding
+    for (size_t tried = 0; tried < spares.codes.size(); ++tried)
+    {
+        const size_t i = spares.nextToUse++ % spares.codes.size();
+        if (now - spares.pressed[i] < spareHandleTime)
+            continue;
+        std::vector<KeySym> syms(static_cast<size_t>(spares.symsPerCode), sym);
+        XChangeKeyboardMapping(display, spares.codes[i], spares.symsPerCode, syms.data(), 1);
+        //The server has to have the new binding before the key is pressed
+        XSync(display, False);
+        spares.bound[i] = sym;
+        spares.pressed[i] = now;
+        return spares.codes[i];
+    }
+    return 0;
+}
+
+//The keysym that types the character, or NoSymbol if it can't be typed
+static KeySym characterToKeysym(char32_t character)
+{
+    switch (character)
+    {
+    case U'\n':
+    case U'\r':
+        return XK_Return;
+    case U'\t':
+        return XK_Tab;
+    case U'\b':
+        return XK_BackSpace;
+    }
+    if (character < 0x20 || (character >= 0x7F && character < 0xA0) || character > 0x10FFFF)
+        return NoSymbol;
+    //Latin-1 keysyms match their code points, everything else has a keysym of its own
+    if (character < 0x100)
+        return static_cast<KeySym>(character);
+    return static_cast<KeySym>(0x01000000 | character);
+}
+
+static void pressKey(Display* display, KeyCode code, bool shift)
+{
+    const KeyCode shiftCode = XKeysymToKeycode(display, XK_Shift_L);
+    if (shift)
+        XTestFakeKeyEvent(display, shiftCode, True, 0);
+    XTestFakeKeyEvent(display, code, True, 0);
+    XTestFakeKeyEvent(display, code, False, 0);
+    if (shift)
+        XTestFakeKeyEvent(display, shiftCode, False, 0);
+}
+
+//Returns false if the character has to wait for a spare key to be free
+static bool typeCharacter(Display* display, char32_t character)
+{
+    const KeySym sym = characterToKeysym(character);
+    if (sym == NoSymbol)
+        return true;
+    //Characters the layout has on their first two levels are typed with the key itself, so the page sees the key it expects
+    if (KeyCode code = XKeysymToKeycode(display, sym))
+    {
+        if (XkbKeycodeToKeysym(display, code, 0, 0) == sym)
+        {
+            pressKey(display, code, false);
+            return true;
+        }
+        if (XkbKeycodeToKeysym(display, code, 0, 1) == sym)
+        {
+            pressKey(display, code, true);
+            return true;
+        }
+    }
+    auto spare = bindSpareKey(display, sym);
+    //Without spare keys the character can't be typed at all
+    if (!spare)
+        return true;
+    if (*spare == 0)
+        return false;
+    pressKey(display, *spare, false);
+    return true;
+}
+
+bool focusForInput(processId, windowHandle target)
+{
+    Display* display = displaySession::get().handle();
+    if (!display || target == 0)
+        return false;
+    XRaiseWindow(display, target);
+    XSetInputFocus(display, target, RevertToParent, CurrentTime);
+    return true;
+}
+
+bool sendInput(windowHandle, const inputAction& action)
+{
+    //Everything goes out on the shared connection, and is only flushed once the due actions have all been queued
+    Display* display = displaySession::get().handle();
+    if (!display)
+        return true;
+
+    switch (action.type)
+    {
+    case inputAction::kind::key:
+    {
+        auto modifier = [&](KeySym sym, bool press) { XTestFakeKeyEvent(display, XKeysymToKeycode(display, sym), press, 0); };
+        if (action.shift)
+            modifier(XK_Shift_L, True);
+        if (action.control)
+            modifier(XK_Control_L, True);
+        if (action.alt)
+            modifier(XK_Alt_L, True);
+        pressKey(display, XKeysymToKeycode(display, action.key), false);
+        if (action.shift)
+            modifier(XK_Shift_L, False);
+        if (action.control)
+            modifier(XK_Control_L, False);
+        if (action.alt)
+            modifier(XK_Alt_L, False);
+        break;
+    }
+    case inputAction::kind::character:
+        return typeCharacter(display, action.character);
+    case inputAction::kind::click:
+    {
+        int x11Button = (action.button == 1) ? Button1 : (action.button == 2) ? Button3 : Button2;
+        XTestFakeMotionEvent(display, -1, action.x, action.y, 0);
+        XTestFakeButtonEvent(display, x11Button, True, 0);
+        XTestFakeButtonEvent(display, x11Button, False, 0);
+        break;
+    }
+    }
+    return true;
+}
+
+void flushInput()
+{
+    if (Display* display = displaySession::get().handle())
+        XFlush(display);
+}
+
+void releaseInput()
+{
+    Display* display = displaySession::get().handle();
+    if (!display)
+        return;
+    auto& spares = getSpareKeys(display);
+    std::vector<KeySym> none(static_cast<size_t>(spares.symsPerCode), NoSymbol);
+    bool changed = false;
+    for (size_t i = 0; i < spares.codes.size(); ++i)
+    {
+        if (spares.bound[i] == NoSymbol)
+            continue;
+        XChangeKeyboardMapping(display, spares.codes[i], spares.symsPerCode, none.data(), 1);
+        spares.bound[i] = NoSymbol;
+        changed = true;
+    }
+    if (changed)
+        XFlush(display);
+}
+#endif
@@ -0,0 +1,230 @@
+#ifdef __linux__
+#include "Metrics.h"
+#include "DisplaySession.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "osmanip/manipulators/colsty.hpp"
+
+//How long a connection has to send its request before it is dropped
+static constexpr auto requestTimeout = std::chrono::seconds(5);
+//Requests are only read as far as the end of their headers, anything bigger isn't a scrape
+static constexpr size_t maxRequest = 8192;
+static constexpr size_t maxConnections = 16;
+
+std::uint64_t windowSystemRequests()
+{
+    Display* display = displaySession::get().handle();
+    //Every request is numbered in turn, the count carries on from where the last connection left off
+    static std::uint64_t previousConnections = 0;
+    static size_t generation = 0;
+    static std::uint64_t last = 0;
+    if (!display)
+        return previousConnections + last;
+    if (generation != displaySession::get().getGeneration())
+    {
+        previousConnections += last;
+        generation = displaySession::get().getGeneration();
+    }
+    last = XNextRequest(display) - 1;
+    return previousConnections + last;
+}
+
+metricsServer::~metricsServer()
+{
+    closeAll();
+}
+
+metricsServer& metricsServer::get()
+{
+    static metricsServer server;
+    return server;
+}
+
+void metricsServer::closeAll()
+{
+    //Closing a descriptor also removes it from the epoll set
+    for (auto& c : connections)
+        ::close(c.fd);
+    connections.clear();
+    for (int fd : listeners)
+        ::close(fd);
+    listeners.clear();
+    if (!socketFile.empty())
+        ::unlink(socketFile.c_str());
+    socketFile.clear();
+    openSocket.clear();
+    openPort = 0;
+    if (source != -1)
+        ::close(source);
+    source = -1;
+}
+
+static void warn(const std::string& message)
+{
+    std::cout << osm::feat(osm::col, "orange") << message << ": " << std::strerror(errno) << ".\n" << osm::feat(osm::rst, "all");
+}
+
+void metricsServer::configure(const std::string& socketPath, int port)
+{
+    if (socketPath == openSocket && port == openPort && (source != -1 || (socketPath.empty() && port == 0)))
+        return;
+    closeAll();
+    if (socketPath.empty() && port <= 0)
+        return;
+
+    source = epoll_create1(EPOLL_CLOEXEC);
+    if (source == -1)
+        return warn("Unable to serve metrics");
+    auto listen = [&](int fd)
+    {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (::listen(fd, 8) == -1 || epoll_ctl(source, EPOLL_CTL_ADD, fd, &event) == -1)
+        {
+            ::close(fd);
+            return false;
+        }
+        listeners.push_back(fd);
+        return true;
+    };
+
+    if (!socketPath.empty())
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        int fd = socketPath.size() < sizeof(address.sun_path) ? socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0) : -1;
+        if (fd != -1)
+        {
+            std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+            //A socket left behind by an earlier run would otherwise stop us binding
+            ::unlink(socketPath.c_str());
+            if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1)
+            {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        if (fd != -1)
+            socketFile = socketPath;
+        if (fd == -1 || !listen(fd))
+            warn("Unable to serve metrics on " + socketPath);
+    }
+    if (port > 0)
+    {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<std::uint16_t>(port));
+        //Only ever served locally
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd != -1)
+        {
+            int reuse = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1)
+            {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        if (fd == -1 || !listen(fd))
+            warn("Unable to serve metrics on port " + std::to_string(port));
+    }
+    //Only retried if the settings change
+    openSocket = socketPath;
+    openPort = port;
+}
+
+void metricsServer::accept(int listener)
+{
+    while (true)
+    {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1)
+            return;
+        if (connections.size() >= maxConnections)
+        {
+            ::close(fd);
+            continue;
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(source, EPOLL_CTL_ADD, fd, &event);
+        connections.push_back({ fd, {}, {}, std::chrono::steady_clock::now() });
+    }
+}
+
+bool metricsServer::serve(connection& c)
+{
+    if (c.response.empty())
+    {
+        char buffer[1024];
+        while (true)
+        {
+            ssize_t count = ::read(c.fd, buffer, sizeof(buffer));
+            if (count > 0)
+            {
+                c.request.append(buffer, static_cast<size_t>(count));
+                if (c.request.size() > maxRequest)
+                    return false;
+                continue;
+            }
+            if (count == 0)
+                return false;
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                return false;
+            break;
+        }
+        if (c.request.find("\r\n\r\n") == std::string::npos)
+            return std::chrono::steady_clock::now() - c.opened < requestTimeout;
+
+        //Whatever was asked for, the metrics are the only thing served
+        const auto body = metricRegistry::get().render();
+        c.response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        //Told when the rest can be written, the request has been read
+        epoll_event event{};
+        event.events = EPOLLOUT;
+        event.data.fd = c.fd;
+        epoll_ctl(source, EPOLL_CTL_MOD, c.fd, &event);
+    }
+
+    while (!c.response.empty())
+    {
+        ssize_t written = ::send(c.fd, c.response.data(), c.response.size(), MSG_NOSIGNAL);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) && std::chrono::steady_clock::now() - c.opened < requestTimeout;
+        }
+        c.response.erase(0, static_cast<size_t>(written));
+    }
+    return false;
+}
+
+void metricsServer::update()
+{
+    if (source == -1)
+        return;
+    for (int listener : listeners)
+        accept(listener);
+    std::erase_if(connections, [&](connection& c)
+    {
+        if (serve(c))
+            return false;
+        ::close(c.fd);
+        return true;
+    });
+}
+#endif
@@ -1,24 +1,29 @@
 #ifdef __linux__
-//Linux monitor enumeration using X11/Xinerama
+//Linux monitor enumeration using X11/Xinerama, cached until XRandR reports a change
 #include <X11/Xlib.h>
 #include <X11/extensions/Xinerama.h>
+#include <X11/extensions/Xrandr.h>
 #include <vector>
 #include <algorithm>
 #include "Rect.h"
 #include "Monitor.h"
+#include "DisplaySession.h"
 #include <stdexcept>
 
-std::vector<rect> getMonitors()
-{
-    std::vector<rect> result;
-    Display* display = XOpenDisplay(nullptr);
-    if (!display)
-        throw std::runtime_error("Failed to open X display");
+static std::vector<rect> cachedMonitors;
+//Xinerama's index for each cached monitor, as used by _NET_WM_FULLSCREEN_MONITORS
+static std::vector<int> cachedIndices;
+static size_t monitorGeneration = 0;
+//The connection the cache was filled from, a new connection may be looking at different monitors
+static size_t cachedDisplayGeneration = 0;
+static bool stale = true;
 
+static std::vector<std::pair<rect, int>> queryMonitors(Display* display)
+{
+    std::vector<std::pair<rect, int>> result;
     int event_base, error_base;
     if (!XineramaQueryExtension(display, &event_base, &error_base) || !XineramaIsActive(display))
     {
-        XCloseDisplay(display);
         throw std::runtime_error("Xinerama extension not available or not active");
     }
 
@@ -26,26 +31,73 @@ std::vector<rect> getMonitors()
     XineramaScreenInfo* screens = XineramaQueryScreens(display, &num_monitors);
     if (!screens)
     {
-        XCloseDisplay(display);
         throw std::runtime_error("Failed to query Xinerama screens");
     }
 
     for (int i = 0; i < num_monitors; ++i)
     {
-        result.push_back({
+        result.push_back({ {
             screens[i].x_org,
             screens[i].y_org,
             screens[i].width,
             screens[i].height
-        });
+        }, screens[i].screen_number });
     }
     XFree(screens);
-    XCloseDisplay(display);
 
-    std::sort(result.begin(), result.end(), [](const rect& a, const rect& b)
+    std::sort(result.begin(), result.end(), [](const auto& a, const auto& b)
     {
-        return a.left == b.left ? a.top < b.top : a.left < b.left;
+        return a.first.left == b.first.left ? a.first.top < b.first.top : a.first.left < b.first.left;
     });
     return result;
 }
-#endif
\ No newline at end of file
+
+const std::vector<rect>& getMonitors()
+{
+    auto& session = displaySession::get();
+    Display* display = session.handle();
+    if (!display)
+        throw std::runtime_error("Failed to open X display");
+
+    //Without XRandR nothing tells us about changes, so the cache can't be trusted
+    int event_base, error_base;
+    const bool reportsChanges = XRRQueryExtension(display, &event_base, &error_base);
+
+    if (stale || !reportsChanges || cachedDisplayGeneration != session.getGeneration())
+    {
+        std::vector<rect> monitors;
+        cachedIndices.clear();
+        for (const auto& [area, index] : queryMonitors(display))
+        {
+            monitors.push_back(area);
+            cachedIndices.push_back(index);
+        }
+        if (monitors != cachedMonitors)
+        {
+            cachedMonitors = std::move(monitors);
+            monitorGeneration++;
+        }
+        cachedDisplayGeneration = session.getGeneration();
+        stale = false;
+    }
+    return cachedMonitors;
+}
+
+size_t getMonitorGeneration()
+{
+    return monitorGeneration;
+}
+
+int getSystemMonitorIndex(int monitor)
+{
+    getMonitors();
+    if (monitor < 0 || monitor >= static_cast<int>(cachedIndices.size()))
+        return monitor;
+    return cachedIndices[monitor];
+}
+
+void invalidateMonitors()
+{
+    stale = true;
+}
+#endif
@@ -2,191 +2,166 @@
 #include "Process.h"
 #include "Monitor.h"
 #include "Settings.h"
-#include <thread>
 #include <chrono>
 #include <string>
 #include <vector>
 #include <span>
 #include <sol/sol.hpp>
 #include "PlatformTypes.h"
-#include <X11/extensions/XTest.h>
+#include "DisplaySession.h"
+#include "WindowQuery.h"
+#include "ChildSupervisor.h"
 #include <X11/Xatom.h>
+#include "osmanip/manipulators/colsty.hpp"
+#include <iostream>
+#include <signal.h>
 
-//Returns true if the window is fullscreen (_NET_WM_STATE_FULLSCREEN)
-bool isFullscreen(windowHandle handle) 
+bool process::isInPosition(const windowState& state, rect area)
 {
-    if (handle == 0) return false;
-    auto oldHandler = XSetErrorHandler([](Display*, XErrorEvent*) { return 0; });
-    Display* display = XOpenDisplay(nullptr);
-    if (!display) return false;
-    Atom netWmState = XInternAtom(display, "_NET_WM_STATE", True);
-    Atom netWmStateFullscreen = XInternAtom(display, "_NET_WM_STATE_FULLSCREEN", True);
-    Atom actualType;
-    int actualFormat;
-    unsigned long nItems, bytesAfter;
-    unsigned char* prop = nullptr;
-    int status = XGetWindowProperty(
-        display,
-        handle,
-        netWmState,
-        0, 1024,
-        False,
-        XA_ATOM,
-        &actualType,
-        &actualFormat,
-        &nItems,
-        &bytesAfter,
-        &prop
-    );
-    bool isFullscreen = false;
-    if (status == Success && prop) 
-    {
-        Atom* atoms = (Atom*)prop;
-        for (unsigned long i = 0; i < nItems; ++i) 
-        {
-            if (atoms[i] == netWmStateFullscreen) 
-            {
-                isFullscreen = true;
-                break;
-            }
-        }
-        XFree(prop);
-    }
-    XCloseDisplay(display);
-    XSetErrorHandler(oldHandler);
-    return isFullscreen;
-}
-
-//Move the window to the specified area and resize it
-void setWindowPos(rect area, windowHandle handle)
-{
-    if (handle == 0) return;
-    auto oldHandler = XSetErrorHandler([](Display*, XErrorEvent*) { return 0; });
-    Display* display = XOpenDisplay(nullptr);
-    if (!display) return;
-    XMoveResizeWindow(display, handle, area.left, area.top, area.width, area.height);
-    XFlush(display);
-    XCloseDisplay(display);
-    XSetErrorHandler(oldHandler);
+    return state.exists && state.bounds.approximately(area) && state.fullscreen;
 }
 
 bool process::isInPosition(rect area) const
 {
-    auto bounds = getBounds();
-    return bounds.approximately(area) && isFullscreen(wHandle);
+    //Geometry, position and state are fetched together
+    return isInPosition(queryWindowStates({ &wHandle, 1 }).front(), area);
 }
 
 //Returns true if the process is a valid window
 bool process::valid() const
 {
     if (wHandle == 0) return false;
-    Display* display = XOpenDisplay(nullptr);
+    Display* display = displaySession::get().handle();
     if (!display) return false;
-    //Suppress X11 BadWindow errors
-    auto oldHandler = XSetErrorHandler([](Display*, XErrorEvent*) { return 0; });
+    //BadWindow errors are suppressed by the session's error handler
     XWindowAttributes attr;
-    bool ok = XGetWindowAttributes(display, wHandle, &attr);
-	XSetErrorHandler(oldHandler);
-    XCloseDisplay(display);
-    return ok;
+    return XGetWindowAttributes(display, wHandle, &attr);
 }
 
-void process::sendMessage(keycode vkCode, bool shiftPress, bool controlPress, bool altPress) const
+rect process::getBounds() const 
 {
-    //Send key event to window using XTest
-    auto oldHandler = XSetErrorHandler([](Display*, XErrorEvent*) { return 0; });
-    Display* display = XOpenDisplay(nullptr);
-    if (!display || wHandle == 0) 
-        return;
-
-    //Set input focus and raise window
-    XRaiseWindow(display, wHandle);
-    XSetInputFocus(display, wHandle, RevertToParent, CurrentTime);
-    KeyCode keycode = XKeysymToKeycode(display, vkCode);
-    if (shiftPress) 
-        XTestFakeKeyEvent(display, XKeysymToKeycode(display, XK_Shift_L), True, 0);
-    if (controlPress) 
-        XTestFakeKeyEvent(display, XKeysymToKeycode(display, XK_Control_L), True, 0);
-    if (altPress) 
-        XTestFakeKeyEvent(display, XKeysymToKeycode(display, XK_Alt_L), True, 0);
-    XTestFakeKeyEvent(display, keycode, True, 0);
-    XTestFakeKeyEvent(display, keycode, False, 0);
-    if (shiftPress) 
-        XTestFakeKeyEvent(display, XKeysymToKeycode(display, XK_Shift_L), False, 0);
-    if (controlPress) 
-        XTestFakeKeyEvent(display, XKeysymToKeycode(display, XK_Control_L), False, 0);
-    if (altPress) 
-        XTestFakeKeyEvent(display, XKeysymToKeycode(display, XK_Alt_L), False, 0);
-    XFlush(display);
-    XCloseDisplay(display);
-    XSetErrorHandler(oldHandler);
+    //Translated to desktop coordinates, as the position alone is relative to the window manager's frame
+    return queryWindowStates({ &wHandle, 1 }).front().bounds;
 }
 
-void process::sendClick(int x, int y, sol::optional<int> buttonType) const
+//Asks the window manager to add or remove a state, the window manager decides whether to honour it
+static void sendWindowState(Display* display, windowHandle handle, bool add, Atom state)
 {
-    //Send mouse click event using XTest
-    auto oldHandler = XSetErrorHandler([](Display*, XErrorEvent*) { return 0; });
-    Display* display = XOpenDisplay(nullptr);
-    if (!display || wHandle == 0) 
-        return;
-
-    //Set input focus and raise window
-    XRaiseWindow(display, wHandle);
-    XSetInputFocus(display, wHandle, RevertToParent, CurrentTime);
-    int button = buttonType.value_or(1);
-    int x11Button = (button == 1) ? Button1 : (button == 2) ? Button3 : Button2;
-
-    XTestFakeMotionEvent(display, -1, x, y, 0);
-    XTestFakeButtonEvent(display, x11Button, True, 0);
-    XTestFakeButtonEvent(display, x11Button, False, 0);
-    XFlush(display);
-    XCloseDisplay(display);
-    XSetErrorHandler(oldHandler);
+    auto& session = displaySession::get();
+    XEvent event{};
+    event.xclient.type = ClientMessage;
+    event.xclient.window = handle;
+    event.xclient.message_type = session.atom("_NET_WM_STATE", false);
+    event.xclient.format = 32;
+    //_NET_WM_STATE_REMOVE = 0, _NET_WM_STATE_ADD = 1
+    event.xclient.data.l[0] = add ? 1 : 0;
+    event.xclient.data.l[1] = static_cast<long>(state);
+    //Source indication, 1 is a normal application
+    event.xclient.data.l[3] = 1;
+    XSendEvent(display, session.root(), False, SubstructureRedirectMask | SubstructureNotifyMask, &event);
 }
 
-rect process::getBounds() const 
+//Tells the window manager which monitor the window should cover when fullscreen
+static void sendFullscreenMonitor(Display* display, windowHandle handle, int systemMonitor)
 {
-    //Get window geometry using XGetWindowAttributes
-    auto oldHandler = XSetErrorHandler([](Display*, XErrorEvent*) { return 0; });
-    Display* display = XOpenDisplay(nullptr);
-    if (!display || wHandle == 0) 
-        return rect{0,0,0,0};
+    auto& session = displaySession::get();
+    XEvent event{};
+    event.xclient.type = ClientMessage;
+    event.xclient.window = handle;
+    event.xclient.message_type = session.atom("_NET_WM_FULLSCREEN_MONITORS", false);
+    event.xclient.format = 32;
+    //Top, bottom, left and right edges all come from the one monitor
+    for (int i = 0; i < 4; i++)
+        event.xclient.data.l[i] = systemMonitor;
+    event.xclient.data.l[4] = 1;
+    XSendEvent(display, session.root(), False, SubstructureRedirectMask | SubstructureNotifyMask, &event);
+}
 
-    XWindowAttributes attr;
-    if (XGetWindowAttributes(display, wHandle, &attr)) 
+//Moves the window one step closer to covering the given area, never waiting on the window manager
+//Each step is sent once, then confirmed by a later check (usually prompted by the window's ConfigureNotify/PropertyNotify), or sent again once it times out
+bool process::moveToMonitor(int monitorIndex, rect area, const windowState* known)
+{
+    //How long a step has to be confirmed before it is sent again
+    static constexpr auto stepTimeout = std::chrono::milliseconds(500);
+    //How many times a step is sent before we give up and start over
+    static constexpr int maxAttempts = 5;
+
+    //Anything part way through is abandoned if there is nothing to place, so its deadline doesn't keep waking us up
+    Display* display = displaySession::get().handle();
+    if (!display || wHandle == 0)
     {
-        XCloseDisplay(display);
-        return rect{attr.x, attr.y, attr.width, attr.height};
+        placing = placementStep::idle;
+        return false;
     }
-    XCloseDisplay(display);
-    XSetErrorHandler(oldHandler);
-    return rect{0,0,0,0};
-}
 
-//Attempts to move the window to the given area and full screen it
-void process::moveToMonitor(rect area) const
-{
-    if (valid())
+    const auto state = known ? *known : queryWindowStates({ &wHandle, 1 }).front();
+    if (!state.exists)
     {
-        //Only try up to 5 times to sort the window, otherwise ignore it and move on
-        int fail = 5;
-        while (!isInPosition(area) && fail-- > 0)
+        placing = placementStep::idle;
+        return false;
+    }
+    const Atom fullscreen = displaySession::get().atom("_NET_WM_STATE_FULLSCREEN", false);
+
+    //The window is on the right monitor if its centre is, even if the window manager didn't give it exactly the size we asked for
+    const int centreX = state.bounds.left + state.bounds.width / 2;
+    const int centreY = state.bounds.top + state.bounds.height / 2;
+    const bool onMonitor = centreX >= area.left && centreX < area.left + area.width && centreY >= area.top && centreY < area.top + area.height;
+
+    const auto now = std::chrono::steady_clock::now();
+    auto send = [&](placementStep step)
+    {
+        if (step != placing)
+            placementAttempts = 0;
+        placing = step;
+        placementAttempts++;
+        placementDeadline = now + stepTimeout;
+        switch (step)
         {
-            //Move to the given monitor
-            setWindowPos(area, wHandle);
-            //Give the window a moment to relocate
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-            //If the window was already full screened, don't undo it
-            //Moving it should already have returned it to a window
-            if (!isFullscreen(wHandle))
-            {
-                static const auto f11 = getKeycode("F11");
-                //Otherwise make it full screen
-                sendMessage(f11);
-            }
+        case placementStep::leavingFullscreen:
+            sendWindowState(display, wHandle, false, fullscreen);
+            break;
+        case placementStep::moving:
+            XMoveResizeWindow(display, wHandle, area.left, area.top, area.width, area.height);
+            break;
+        case placementStep::enteringFullscreen:
+            //Window managers that support it will fullscreen onto exactly this monitor, the rest use wherever the window now is
+            sendFullscreenMonitor(display, wHandle, getSystemMonitorIndex(monitorIndex));
+            sendWindowState(display, wHandle, true, fullscreen);
+            break;
+        default:
+            break;
         }
+        XFlush(display);
+    };
+
+    //Each step is confirmed by the window reaching the state it asked for
+    const bool confirmed =
+        placing == placementStep::idle ||
+        (placing == placementStep::leavingFullscreen && !state.fullscreen) ||
+        (placing == placementStep::moving && onMonitor) ||
+        (placing == placementStep::enteringFullscreen && state.fullscreen);
+    if (!confirmed && now < placementDeadline)
+        return false;
+
+    //Works out the next step from where the window actually is, so steps the window manager skipped for us are skipped here too
+    placementStep next;
+    if (!state.fullscreen)
+        next = onMonitor ? placementStep::enteringFullscreen : placementStep::moving;
+    else if (placing == placementStep::idle)
+        //A fullscreen window may be moved directly, by telling the window manager which monitor it should cover
+        next = placementStep::enteringFullscreen;
+    else
+        next = placementStep::leavingFullscreen;
+
+    if (next == placing && placementAttempts >= maxAttempts)
+    {
+        std::cout << osm::feat(osm::col, "orange") << "The window for monitor " << monitorIndex << " could not be placed, trying again.\n" << osm::feat(osm::rst, "all");
+        placing = placementStep::idle;
+        return false;
     }
+
+    send(next);
+    return false;
 }
 
 //Sends a close request to the window
@@ -194,10 +169,10 @@ void process::close() const
 {
     if (valid())
     {
-        //Send SIGKILL to the process
+        //Send SIGKILL to the process, the supervisor reaps it once it has gone
         if (pId > 0)
         {
-            kill(pId, SIGKILL);
+            childSupervisor::get().signal(pId, SIGKILL);
         }
     }
 }
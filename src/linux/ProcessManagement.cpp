@@ -7,53 +7,105 @@
 #include <stdexcept>
 #include <sstream>
 #include <unistd.h>
+#include <fcntl.h>
 #include <iomanip>
-#include <dirent.h>
 #include <algorithm>
-#include <X11/Xatom.h>
+#include <cstdlib>
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
 #include "PlatformTypes.h"
-#include <fstream>
+#include "DisplaySession.h"
+#include "ProcessTable.h"
+#include "ChildSupervisor.h"
+#include "DevTools.h"
+#include "Monitor.h"
 #include <signal.h>
 #include "Settings.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include <chrono>
 #include <thread>
 #include "osmanip/manipulators/colsty.hpp"
+#include "WindowEvents.h"
+#include <poll.h>
+#include <filesystem>
 
-void createProcess(const std::string& path, const std::string& args) 
+//Finds the executable the way execvp would, so the child doesn't have to
+static std::string resolveExecutable(const std::string& path)
 {
-    //Launch a process using fork and execvp
+    if (path.find('/') != std::string::npos)
+        return path;
+    const char* searchPath = getenv("PATH");
+    std::istringstream directories(searchPath ? searchPath : "/usr/local/bin:/usr/bin:/bin");
+    std::string directory;
+    while (std::getline(directories, directory, ':'))
+    {
+        //An empty entry means the working directory
+        auto candidate = (directory.empty() ? std::string(".") : directory) + "/" + path;
+        if (access(candidate.c_str(), X_OK) == 0)
+            return candidate;
+    }
+    return path;
+}
+
+processId createProcess(const std::string& path, const std::string& args, std::span<const std::string> extraArgs, std::span<const int> inheritFds) 
+{
+    //Everything the child needs is prepared up front, as it may only make async-signal-safe calls
+    //Another thread (e.g. a worker saving a screenshot) may have held a lock, such as malloc's, when we forked
+    const std::string executable = resolveExecutable(path);
+
+    //Build argument list
+    std::vector<std::string> argList;
+    argList.push_back(path);
+    //Split args by spaces
+    std::istringstream iss(args);
+    std::string token;
+    while (iss >> std::quoted(token)) 
+    {
+        argList.push_back(token);
+    }
+
+    iss = std::istringstream(appSettings::get().startArgs);
+    while (iss >> std::quoted(token)) 
+    {
+        argList.push_back(token);
+    }
+    argList.insert(argList.end(), extraArgs.begin(), extraArgs.end());
+    argList.push_back("--new-window");
+    //Convert to char* array
+    std::vector<char*> argv;
+    for (auto& s : argList) argv.push_back(const_cast<char*>(s.c_str()));
+    argv.push_back(nullptr);
+
+    //Set DISPLAY environment variable to :0 if not already set
+    std::string defaultDisplay = "DISPLAY=:0";
+    std::vector<char*> envp;
+    for (char** variable = environ; *variable; ++variable)
+        envp.push_back(*variable);
+    if (!getenv("DISPLAY"))
+        envp.push_back(defaultDisplay.data());
+    envp.push_back(nullptr);
+
+    //Where the inherited descriptors are moved out of the way to
+    std::vector<int> inherited(inheritFds.size(), -1);
+    const int firstFree = 3 + static_cast<int>(inheritFds.size());
+
+    //Launch a process using fork and execve
     pid_t pid = fork();
     if (pid == 0) 
     {
         //Child process
-        //Set DISPLAY environment variable to :0 if not already set
-        if (!getenv("DISPLAY")) 
-        {
-            setenv("DISPLAY", ":0", 1);
-        }
-        //Build argument list
-        std::vector<std::string> argList;
-        argList.push_back(path);
-        //Split args by spaces
-        std::istringstream iss(args);
-        std::string token;
-        while (iss >> std::quoted(token)) 
+        //Move the inherited descriptors out of the way first, so placing one can't overwrite another
+        for (size_t i = 0; i < inheritFds.size(); ++i)
+            inherited[i] = fcntl(inheritFds[i], F_DUPFD_CLOEXEC, firstFree);
+        for (size_t i = 0; i < inherited.size(); ++i)
         {
-            argList.push_back(token);
+            //dup2 clears close-on-exec, so only these survive into the new program
+            if (inherited[i] == -1 || dup2(inherited[i], 3 + static_cast<int>(i)) == -1)
+                _exit(127);
         }
-
-        iss = std::istringstream(appSettings::get().startArgs);
-        while (iss >> std::quoted(token)) 
-        {
-            argList.push_back(token);
-        }
-        argList.push_back("--new-window");
-        //Convert to char* array
-        std::vector<char*> argv;
-        for (auto& s : argList) argv.push_back(const_cast<char*>(s.c_str()));
-        argv.push_back(nullptr);
-        execvp(path.c_str(), argv.data());
-        //If execvp fails
+        execve(executable.c_str(), argv.data(), envp.data());
+        //If execve fails
         _exit(127);
     } 
     else if (pid < 0) 
@@ -61,171 +113,396 @@ void createProcess(const std::string& path, const std::string& args)
         //Fork failed
         throw std::runtime_error("Failed to fork process");
     }
-    //Parent process: do nothing, child runs browser
+    //Parent process: the child runs the browser, we just keep an eye on it
+    childSupervisor::get().track(pid);
+    countLaunch();
+    return pid;
+}
+
+//Returns the name of the given process, or an empty string if it doesn't exist
+std::string getProcessName(processId pid)
+{
+    return processTable::get().nameOf(pid);
 }
 
 std::vector<processId> getActiveProcesses(std::string_view nameFilter = "") 
 {
-    std::vector<processId> result;
-    DIR* proc = opendir("/proc");
-    if (!proc) return result;
-    struct dirent* entry;
-    while ((entry = readdir(proc)) != nullptr) 
+    auto& table = processTable::get();
+    table.scan();
+    return table.withName(nameFilter);
+}
+
+//A window managed by the window manager, and what it tells us about its owner
+struct clientWindow
+{
+    windowHandle window = 0;
+    processId pid = 0;
+    //The two halves of WM_CLASS
+    std::string instance;
+    std::string windowClass;
+};
+
+//Lists every managed window in stacking order, with its _NET_WM_PID and WM_CLASS
+//All property lookups are sent as one batch, so this costs two round trips however many windows there are
+std::vector<clientWindow> queryClientWindows() 
+{
+    std::vector<clientWindow> result;
+    auto& session = displaySession::get();
+    Display* display = session.handle();
+    if (!display) return result;
+    const xcb_atom_t atomPID = session.atom("_NET_WM_PID");
+    const xcb_atom_t netClientListStacking = session.atom("_NET_CLIENT_LIST_STACKING");
+    if (atomPID == None || netClientListStacking == None) return result;
+
+    xcb_connection_t* connection = XGetXCBConnection(display);
+
+    //Query _NET_CLIENT_LIST_STACKING for all managed windows
+    auto* clientList = xcb_get_property_reply(connection,
+        xcb_get_property(connection, 0, session.root(), netClientListStacking, XCB_ATOM_WINDOW, 0, 1024), nullptr);
+    if (!clientList) return result;
+
+    auto* windows = static_cast<xcb_window_t*>(xcb_get_property_value(clientList));
+    int count = xcb_get_property_value_length(clientList) / static_cast<int>(sizeof(xcb_window_t));
+
+    //Request the properties of every window before reading any of the replies
+    std::vector<std::pair<xcb_get_property_cookie_t, xcb_get_property_cookie_t>> cookies;
+    cookies.reserve(count);
+    for (int i = 0; i < count; ++i)
+    {
+        cookies.emplace_back(
+            xcb_get_property(connection, 0, windows[i], atomPID, XCB_ATOM_CARDINAL, 0, 1),
+            xcb_get_property(connection, 0, windows[i], XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, 256));
+    }
+
+    for (int i = 0; i < count; ++i)
     {
-        //Only directories with all digits are PIDs
-        if (entry->d_type == DT_DIR) 
+        clientWindow& client = result.emplace_back();
+        client.window = windows[i];
+
+        xcb_generic_error_t* error = nullptr;
+        auto* propPID = xcb_get_property_reply(connection, cookies[i].first, &error);
+        std::free(error);
+        error = nullptr;
+        if (propPID && xcb_get_property_value_length(propPID) == sizeof(uint32_t))
         {
-            std::string pidStr(entry->d_name);
-            if (!pidStr.empty() && std::all_of(pidStr.begin(), pidStr.end(), ::isdigit)) 
-            {
-                processId pid = static_cast<processId>(std::stoi(pidStr));
-                std::string commPath = "/proc/" + pidStr + "/comm";
-                std::ifstream commFile(commPath);
-                std::string procName;
-                if (commFile && std::getline(commFile, procName)) 
-                {
-                    if (!procName.empty() && procName.back() == '\n') procName.pop_back();
-                } 
-                else 
-                {
-                    procName = "";
-                }
+            client.pid = static_cast<processId>(*static_cast<uint32_t*>(xcb_get_property_value(propPID)));
+        }
+        std::free(propPID);
 
-                if (nameFilter.empty() || procName == nameFilter) 
-                {
-                    result.push_back(pid);
-                }
+        //WM_CLASS is two null terminated strings, instance then class
+        auto* propClass = xcb_get_property_reply(connection, cookies[i].second, &error);
+        std::free(error);
+        if (propClass)
+        {
+            std::string_view value(static_cast<const char*>(xcb_get_property_value(propClass)), xcb_get_property_value_length(propClass));
+            auto split = value.find('\0');
+            client.instance = value.substr(0, split);
+            if (split != std::string_view::npos)
+            {
+                auto rest = value.substr(split + 1);
+                client.windowClass = rest.substr(0, rest.find('\0'));
             }
         }
+        std::free(propClass);
     }
-    closedir(proc);
+    std::free(clientList);
     return result;
 }
-void findWindowsByPID(Display* display, Atom atomPID, processId pId, std::vector<windowHandle>& result) 
+
+//Finds the managed windows belonging to any of the given processes, in stacking order
+std::vector<std::pair<processId, windowHandle>> findWindowsByPIDs(std::span<const processId> pIds) 
 {
-    //Query _NET_CLIENT_LIST_STACKING for all managed windows
-    Window root = DefaultRootWindow(display);
-    Atom netClientListStacking = XInternAtom(display, "_NET_CLIENT_LIST_STACKING", True);
-    Atom actualType;
-    int actualFormat;
-    unsigned long nItems, bytesAfter;
-    unsigned char* prop = nullptr;
-    int status = XGetWindowProperty(
-        display,
-        root,
-        netClientListStacking,
-        0, 1024,
-        False,
-        XA_WINDOW,
-        &actualType,
-        &actualFormat,
-        &nItems,
-        &bytesAfter,
-        &prop
-    );
-    if (status == Success && prop && nItems > 0) 
-    {
-        Window* stackingOrder = (Window*)prop;
-        for (unsigned long i = 0; i < nItems; ++i) 
+    std::vector<std::pair<processId, windowHandle>> result;
+    if (pIds.empty()) return result;
+    for (const auto& client : queryClientWindows())
+    {
+        if (std::find(pIds.begin(), pIds.end(), client.pid) != pIds.end())
         {
-            Window win = stackingOrder[i];
-            //Check _NET_WM_PID for each window
-            Atom actualTypePID;
-            int actualFormatPID;
-            unsigned long nItemsPID, bytesAfterPID;
-            unsigned char* propPID = nullptr;
-            int statusPID = XGetWindowProperty(
-                display,
-                win,
-                atomPID,
-                0, 1,
-                False,
-                XA_CARDINAL,
-                &actualTypePID,
-                &actualFormatPID,
-                &nItemsPID,
-                &bytesAfterPID,
-                &propPID
-            );
-            if (statusPID == Success && propPID && nItemsPID == 1) 
-            {
-                processId winPID = *(processId*)propPID;
-                if (winPID == pId) {
-                    result.push_back(win);
-                }
-            }
-            if (propPID) XFree(propPID);
+            result.emplace_back(client.pid, client.window);
         }
-        XFree(prop);
     }
+    return result;
 }
 
 std::vector<windowHandle> FindVisibleWindowsByProcessId(processId pId) 
 {
     //Get the window handle for a given process id
     std::vector<windowHandle> result;
-    Display* display = XOpenDisplay(nullptr);
-    if (!display) return result;
-    Atom atomPID = XInternAtom(display, "_NET_WM_PID", True);
-    if (atomPID != None) 
+    for (const auto& [pid, win] : findWindowsByPIDs({ &pId, 1 }))
     {
-        findWindowsByPID(display, atomPID, pId, result);
+        result.push_back(win);
     }
-    XCloseDisplay(display);
     return result;
 }
 
 std::vector<std::pair<processId, windowHandle>> getMostRecentProcessesWithName(const std::string& name) 
 {
-    //Find all active processes
-    std::vector<std::pair<processId, windowHandle>> result;
+    //Find all active processes, then find all of their windows in one pass
     auto pids = getActiveProcesses(name);
-    
-    //For every id, find the window handles
-    for (const auto& pid : pids) 
+    return findWindowsByPIDs(pids);
+}
+
+void closeAllExisting() 
+{
+    countCloseAll();
+    //Find all browser processes by name and send SIGTERM
+    auto processes = getMostRecentProcessesWithName(appSettings::get().processName);
+    for (const auto& [pid, win] : processes) 
     {
-        auto windows = FindVisibleWindowsByProcessId(pid);
-        for (const auto& win : windows) 
+        childSupervisor::get().signal(pid, SIGTERM); //or SIGKILL for force
+    }
+}
+
+//Isolated profile directories and the launch currently using each of them
+static std::vector<std::pair<std::filesystem::path, processId>> profiles;
+
+//Returns the index of a profile directory that no running launch is using, reusing old ones where possible
+//Two browsers can't share a profile, the second would hand its window to the first
+static size_t claimProfile()
+{
+    for (size_t i = 0; i < profiles.size(); ++i)
+    {
+        auto& pid = profiles[i].second;
+        if (pid <= 0 || !childSupervisor::get().running(pid))
         {
-            result.emplace_back(pid, win);
+            pid = 0;
+            return i;
         }
     }
+    profiles.emplace_back(std::filesystem::absolute(appSettings::get().profileDirectory) / std::to_string(profiles.size()), 0);
+    return profiles.size() - 1;
+}
+
+//Returns the index of the launch the window belongs to, or the size of launches if it isn't recognised
+static size_t matchLaunch(const clientWindow& client, std::span<const pendingLaunch> launches)
+{
+    for (size_t i = 0; i < launches.size(); ++i)
+    {
+        if (!launches[i].windowClass.empty() && (client.windowClass == launches[i].windowClass || client.instance == launches[i].windowClass))
+            return i;
+    }
+    //The browser may be a descendant of what we forked, e.g. if the executable is a wrapper
+    for (size_t i = 0; i < launches.size(); ++i)
+    {
+        if (launches[i].child > 0 && processTable::get().isDescendantOf(client.pid, launches[i].child))
+            return i;
+    }
+    return launches.size();
+}
+
+std::optional<pendingLaunch> beginLaunch(const std::string& url, std::span<const std::string> extraArgs)
+{
+    const auto& settings = appSettings::get();
+    pendingLaunch launch;
+    launch.url = url;
+    std::vector<std::string> args(extraArgs.begin(), extraArgs.end());
+    if (!settings.isolateWindows)
+    {
+        launch.child = createProcess(settings.executableName, url, args);
+        return launch;
+    }
+
+    //A profile of its own makes the browser a new process (our child) rather than a window of an existing one
+    static size_t launchCount = 0;
+    launch.windowClass = "Kiosk" + std::to_string(++launchCount);
+    size_t profile = claimProfile();
+    args.push_back("--class=" + launch.windowClass);
+    args.push_back("--user-data-dir=" + profiles[profile].first.string());
+    args.push_back("--no-first-run");
+    args.push_back("--no-default-browser-check");
+    //The browser is our child, so it can be handed a DevTools pipe for navigating without restarting it
+    std::optional<devToolsPipe> pipe;
+    if (settings.devTools)
+        pipe = devTools::get().createPipe();
+    if (pipe)
+        args.push_back("--remote-debugging-pipe");
+    try
+    {
+        launch.child = createProcess(settings.executableName, url, args, pipe ? devTools::browserEnds(*pipe) : std::vector<int>{});
+    }
+    catch (...)
+    {
+        if (pipe)
+            devTools::get().open(0, *pipe);
+        throw;
+    }
+    if (pipe)
+        devTools::get().open(launch.child, *pipe);
+    profiles[profile].second = launch.child;
+    return launch;
+}
 
+std::vector<std::optional<std::pair<processId, windowHandle>>> findLaunchedWindows(std::span<const pendingLaunch> launches, std::span<const windowHandle> known)
+{
+    std::vector<std::optional<std::pair<processId, windowHandle>>> result(launches.size());
+    if (launches.empty())
+        return result;
+    processTable::get().scan();
+    for (const auto& client : queryClientWindows())
+    {
+        if (std::find(known.begin(), known.end(), client.window) != known.end())
+            continue;
+        size_t index = matchLaunch(client, launches);
+        //The first window of each launch is the one we want
+        if (index != launches.size() && !result[index])
+            result[index] = { client.pid, client.window };
+    }
     return result;
 }
 
-void closeAllExisting() 
+std::vector<std::string> offscreenLaunchArgs()
 {
-    //Find all browser processes by name and send SIGTERM
-    auto processes = getMostRecentProcessesWithName(appSettings::get().processName);
-    for (const auto& [pid, win] : processes) 
+    int right = 0;
+    for (const auto& m : getMonitors())
+        right = std::max(right, m.left + m.width);
+    return { "--window-position=" + std::to_string(right) + ",0", "--window-size=800,600" };
+}
+
+void closeLaunch(const pendingLaunch& launch)
+{
+    //An isolated browser is only ours, anything else may be sharing its process with other windows
+    if (!launch.windowClass.empty() && launch.child > 0)
+        childSupervisor::get().signal(launch.child, SIGTERM);
+}
+
+void minimiseWindow(windowHandle handle)
+{
+    auto& session = displaySession::get();
+    Display* display = session.handle();
+    if (!display || handle == 0)
+        return;
+    XIconifyWindow(display, handle, DefaultScreen(display));
+    XFlush(display);
+}
+
+void restoreWindow(windowHandle handle)
+{
+    auto& session = displaySession::get();
+    Display* display = session.handle();
+    const Atom activeWindow = session.atom("_NET_ACTIVE_WINDOW");
+    if (!display || handle == 0)
+        return;
+    if (activeWindow == None)
     {
-        kill(pid, SIGTERM); //or SIGKILL for force
+        XMapRaised(display, handle);
+        XFlush(display);
+        return;
     }
+    //Activating an iconified window asks the window manager to show it again
+    XEvent event{};
+    event.xclient.type = ClientMessage;
+    event.xclient.window = handle;
+    event.xclient.message_type = activeWindow;
+    event.xclient.format = 32;
+    //Sent on behalf of a pager, which window managers don't second guess
+    event.xclient.data.l[0] = 2;
+    event.xclient.data.l[1] = CurrentTime;
+    XSendEvent(display, session.root(), False, SubstructureRedirectMask | SubstructureNotifyMask, &event);
+    XFlush(display);
 }
 
-std::optional<std::pair<processId, windowHandle>> startProcess(const std::string& url, std::span<const windowHandle> existing, windowHandle self) 
+std::vector<std::optional<std::pair<processId, windowHandle>>> startProcesses(std::span<const std::string> urls, std::span<const windowHandle> existing)
 {
-    //Launch process
-    createProcess(appSettings::get().executableName, url);
-    //Wait for process to start and window to appear
-    std::this_thread::sleep_for(std::chrono::seconds(appSettings::get().loadTime));
-    auto instances = getMostRecentProcessesWithName(appSettings::get().processName);
-    //Filter out windows already in 'existing'
-    std::erase_if(instances, [&](const auto& l) 
-        { return l.second != self && std::find(existing.begin(), existing.end(), l.second) != existing.end(); });
-    if (instances.size() == 0)
+    std::vector<std::optional<std::pair<processId, windowHandle>>> result(urls.size());
+    if (urls.empty())
+        return result;
+    const auto& settings = appSettings::get();
+
+    //Any window open before we launch isn't one of ours, even if nobody has claimed it
+    std::vector<windowHandle> known(existing.begin(), existing.end());
+    for (const auto& client : queryClientWindows())
+        known.push_back(client.window);
+
+    //Subscribes to the client list before launching, so no new window can be missed
+    const int source = windowEventSource();
+
+    //Launch everything up front, the browsers start in parallel
+    std::vector<pendingLaunch> launches;
+    for (const auto& url : urls)
     {
-        std::cout << osm::feat(osm::col, "orange") << "Failed to register process and will reset. Consider increasing LOADTIME.\n" << osm::feat(osm::rst, "all");
-        closeAllExisting();
-        return std::nullopt;
+        traceSpan span("launch browser", url);
+        launches.push_back(*beginLaunch(url));
     }
-    if (instances.size() > 1)
+
+    size_t remaining = urls.size();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(settings.launchTimeout);
+    bool rescan = true;
+    //Everything seen while waiting is for the window supervisor, and handed back once we are done
+    //Handing it back sooner would make the deferred events look pending, and we'd never wait
+    windowEvents accumulated;
+    std::optional<traceSpan> waiting;
+    waiting.emplace("wait for windows", std::to_string(urls.size()) + " windows");
+    while (remaining > 0)
     {
-        std::cout << osm::feat(osm::col, "orange") << "Failed to register process and will reset. Too many processes were found.\n" << osm::feat(osm::rst, "all");
-        closeAllExisting();
-        return std::nullopt;
+        if (rescan)
+        {
+            rescan = false;
+            processTable::get().scan();
+            for (const auto& client : queryClientWindows())
+            {
+                if (remaining == 0)
+                    break;
+                if (std::find(known.begin(), known.end(), client.window) != known.end())
+                    continue;
+
+                size_t index = matchLaunch(client, launches);
+                if (index == launches.size() && !settings.isolateWindows)
+                {
+                    //Without tags all we can go on is the process name, and hand windows out in launch order
+                    if (getProcessName(client.pid) != settings.processName)
+                        continue;
+                    index = std::find(result.begin(), result.end(), std::nullopt) - result.begin();
+                }
+                //Anything we can't attribute (or a second window from the same launch) is left alone
+                if (index == launches.size() || result[index])
+                    continue;
+                known.push_back(client.window);
+                result[index] = { client.pid, client.window };
+                remaining--;
+                traceRecorder::get().mark("window appeared", urls[index]);
+            }
+            continue;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+            break;
+        auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+        if (source == -1)
+        {
+            //Without window events all we can do is look again shortly
+            std::this_thread::sleep_for(std::min(timeout, std::chrono::milliseconds(100)));
+            rescan = true;
+            continue;
+        }
+        //XPending also flushes our own requests, which must happen before we wait on the socket
+        Display* display = displaySession::get().handle();
+        if (!display || XPending(display) == 0)
+        {
+            pollfd pfd{ source, POLLIN, 0 };
+            poll(&pfd, 1, static_cast<int>(timeout.count()));
+        }
+        auto events = collectWindowEvents();
+        rescan = events.clientListChanged;
+        accumulated.merge(events);
     }
-    return instances.front();
+    deferWindowEvents(accumulated);
+    waiting.reset();
+
+    for (size_t i = 0; i < urls.size(); ++i)
+    {
+        if (result[i])
+            continue;
+        countFailedRegistration();
+        std::cout << osm::feat(osm::col, "orange") << "Failed to register process for " << urls[i] << ", no window appeared. Consider increasing LAUNCHTIMEOUT.\n" << osm::feat(osm::rst, "all");
+        //An isolated browser is only ours, so stop it rather than leave a window nobody will claim
+        closeLaunch(launches[i]);
+    }
+    return result;
+}
+
+std::optional<std::pair<processId, windowHandle>> startProcess(const std::string& url, std::span<const windowHandle> existing, windowHandle) 
+{
+    return startProcesses({ &url, 1 }, existing).front();
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,165 @@
+#ifdef __linux__
+#include "ProcessTable.h"
+#include <charconv>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+processTable::~processTable()
+{
+    if (proc)
+        closedir(proc);
+}
+
+processTable& processTable::get()
+{
+    static processTable table;
+    return table;
+}
+
+bool processTable::readStat(processId pid, entry& result)
+{
+    if (!proc && !(proc = opendir("/proc")))
+        return false;
+    char path[32];
+    std::snprintf(path, sizeof(path), "%d/stat", static_cast<int>(pid));
+    int fd = openat(dirfd(proc), path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+    ssize_t length = read(fd, buffer.data(), buffer.size());
+    ::close(fd);
+    if (length <= 0)
+        return false;
+
+    //Format is "pid (name) state ppid ...", the name may itself contain spaces and brackets
+    std::string_view stat(buffer.data(), static_cast<size_t>(length));
+    auto nameStart = stat.find('(');
+    auto nameEnd = stat.rfind(')');
+    if (nameStart == std::string_view::npos || nameEnd == std::string_view::npos || nameEnd + 2 > stat.size())
+        return false;
+
+    result.pid = pid;
+    result.name = stat.substr(nameStart + 1, nameEnd - nameStart - 1);
+
+    //Fields are numbered from 1, the one after the name is field 3
+    auto fields = stat.substr(nameEnd + 2);
+    int field = 3;
+    while (!fields.empty() && field <= 22)
+    {
+        auto split = fields.find(' ');
+        auto value = fields.substr(0, split);
+        if (field == 4)
+            std::from_chars(value.data(), value.data() + value.size(), result.parent);
+        else if (field == 22)
+            std::from_chars(value.data(), value.data() + value.size(), result.startTime);
+        if (split == std::string_view::npos)
+            break;
+        fields.remove_prefix(split + 1);
+        field++;
+    }
+    return field >= 22;
+}
+
+void processTable::scan()
+{
+    if (!proc)
+    {
+        proc = opendir("/proc");
+        if (!proc)
+            return;
+    }
+    else
+    {
+        rewinddir(proc);
+    }
+
+    scanCount++;
+    while (dirent* dir = readdir(proc))
+    {
+        //Only directories with all digits are PIDs
+        if (dir->d_type != DT_DIR)
+            continue;
+        std::string_view name(dir->d_name);
+        processId pid = 0;
+        auto [end, error] = std::from_chars(name.data(), name.data() + name.size(), pid);
+        if (error != std::errc() || end != name.data() + name.size())
+            continue;
+
+        lastSeen[pid] = scanCount;
+        if (entries.contains(pid))
+            continue;
+        entry found;
+        if (readStat(pid, found))
+            entries.emplace(pid, std::move(found));
+    }
+
+    //Forget anything that has exited
+    std::erase_if(lastSeen, [&](const auto& seen)
+    {
+        if (seen.second == scanCount)
+            return false;
+        entries.erase(seen.first);
+        return true;
+    });
+}
+
+const processTable::entry* processTable::verify(processId pid)
+{
+    auto it = entries.find(pid);
+    if (it == entries.end())
+        return nullptr;
+    entry current;
+    if (readStat(pid, current) && current.startTime == it->second.startTime)
+        return &it->second;
+    //The pid now belongs to something else (or nothing), so reread it
+    if (current.pid == pid && !current.name.empty())
+    {
+        it->second = std::move(current);
+        return &it->second;
+    }
+    entries.erase(it);
+    lastSeen.erase(pid);
+    return nullptr;
+}
+
+std::vector<processId> processTable::withName(std::string_view name)
+{
+    std::vector<processId> result;
+    for (const auto& [pid, info] : entries)
+    {
+        if (name.empty() || info.name == name)
+            result.push_back(pid);
+    }
+    if (name.empty())
+        return result;
+    //Only the matches are checked for pid reuse, which is far fewer than everything
+    std::erase_if(result, [&](processId pid) { auto info = verify(pid); return !info || info->name != name; });
+    return result;
+}
+
+std::string processTable::nameOf(processId pid)
+{
+    if (auto info = verify(pid))
+        return info->name;
+    entry found;
+    if (!readStat(pid, found))
+        return "";
+    lastSeen[pid] = scanCount;
+    return entries.emplace(pid, std::move(found)).first->second.name;
+}
+
+bool processTable::isDescendantOf(processId pid, processId ancestor)
+{
+    //Walk up the tree, the depth limit guards against a loop from stale entries
+    for (int depth = 0; pid > 0 && depth < 64; ++depth)
+    {
+        if (pid == ancestor)
+            return true;
+        auto it = entries.find(pid);
+        if (it == entries.end())
+            return false;
+        pid = it->second.parent;
+    }
+    return false;
+}
+#endif
@@ -47,8 +47,30 @@ bool isChromium()
     return !failed;
 }
 
+//Not fatal, windows are just restarted rather than navigated
+void checkDevTools()
+{
+    const auto& settings = appSettings::get();
+    if (settings.devTools && !settings.isolateWindows)
+    {
+        std::cout << osm::feat(osm::col, "orange") << "Warning: DevTools requires IsolateWindows, windows will be restarted to change page instead.\n" << osm::feat(osm::rst, "all");
+    }
+}
+
+//Not fatal, but the profile the user asked for is not the one the windows get
+void checkIsolatedProfiles()
+{
+    const auto& settings = appSettings::get();
+    if (settings.isolateWindows && settings.startArgs.find("--user-data-dir") != std::string::npos)
+    {
+        std::cout << osm::feat(osm::col, "orange") << "Warning: IsolateWindows gives every window its own profile in ProfileDirectory, the --user-data-dir in StartArgs will be ignored.\n" << osm::feat(osm::rst, "all");
+    }
+}
+
 bool runStartupChecks() 
 {
+    checkDevTools();
+    checkIsolatedProfiles();
     bool valid = true;
     if (!isX11()) valid = false;
     if (!isChromium()) valid = false;
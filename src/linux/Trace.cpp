@@ -0,0 +1,53 @@
+#ifdef __linux__
+#include "Trace.h"
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+
+//The handler can only do so much, so it writes to a pipe that the main loop waits on
+static int signalPipe[2] = { -1, -1 };
+
+static void onTraceSignal(int)
+{
+    const int saved = errno;
+    const char byte = 0;
+    [[maybe_unused]] auto ignored = ::write(signalPipe[1], &byte, 1);
+    errno = saved;
+}
+
+void listenForTraceSignal()
+{
+    if (signalPipe[0] != -1)
+        return;
+    if (pipe2(signalPipe, O_NONBLOCK | O_CLOEXEC) == -1)
+    {
+        signalPipe[0] = signalPipe[1] = -1;
+        std::cout << osm::feat(osm::col, "orange") << "Unable to listen for SIGUSR1, the trace can only be saved from lua.\n" << osm::feat(osm::rst, "all");
+        return;
+    }
+    struct sigaction action{};
+    action.sa_handler = &onTraceSignal;
+    sigemptyset(&action.sa_mask);
+    //Anything else that was interrupted carries on as if nothing happened
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, nullptr);
+}
+
+int traceSignalSource()
+{
+    return signalPipe[0];
+}
+
+bool takeTraceSignal()
+{
+    if (signalPipe[0] == -1)
+        return false;
+    bool received = false;
+    char buffer[64];
+    //Several signals before we got round to it still only save once
+    while (::read(signalPipe[0], buffer, sizeof(buffer)) > 0)
+        received = true;
+    return received;
+}
+#endif
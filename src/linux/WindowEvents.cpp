@@ -0,0 +1,145 @@
+#ifdef __linux__
+#include "WindowEvents.h"
+#include "DisplaySession.h"
+#include "Monitor.h"
+#include <X11/extensions/Xrandr.h>
+#include <unordered_set>
+#include <algorithm>
+#include <utility>
+
+//Windows we have asked to be notified about, kept so we can resubscribe after a reconnect
+static std::unordered_set<Window> watchedWindows;
+//The connection generation our subscriptions were made on
+static size_t subscribedGeneration = 0;
+//Where XRandR events start on the current connection, or -1 if it has no XRandR
+static int randrEventBase = -1;
+//Events collected by someone who only needed part of them
+static windowEvents deferredEvents;
+
+static void subscribe(Display* display, Window window)
+{
+    XSelectInput(display, window, StructureNotifyMask | PropertyChangeMask);
+}
+
+//Returns the shared connection, making sure our event subscriptions exist on it
+static Display* subscribedDisplay()
+{
+    auto& session = displaySession::get();
+    Display* display = session.handle();
+    if (!display)
+        return nullptr;
+
+    //Subscriptions belong to a connection, so a new connection needs them all again
+    if (subscribedGeneration != session.getGeneration())
+    {
+        subscribedGeneration = session.getGeneration();
+        //The root window carries _NET_CLIENT_LIST
+        XSelectInput(display, session.root(), PropertyChangeMask);
+        //Monitor hotplugs and layout changes are reported on the root too
+        int errorBase;
+        if (XRRQueryExtension(display, &randrEventBase, &errorBase))
+            XRRSelectInput(display, session.root(), RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask | RROutputChangeNotifyMask);
+        else
+            randrEventBase = -1;
+        //Whatever we knew about the monitors came from the old connection
+        invalidateMonitors();
+        for (auto window : watchedWindows)
+            subscribe(display, window);
+        XFlush(display);
+    }
+    return display;
+}
+
+void watchWindow(windowHandle handle)
+{
+    if (handle == 0)
+        return;
+    Display* display = subscribedDisplay();
+    if (!display)
+        return;
+    if (watchedWindows.insert(handle).second)
+    {
+        subscribe(display, handle);
+        XFlush(display);
+    }
+}
+
+int windowEventSource()
+{
+    Display* display = subscribedDisplay();
+    return display ? ConnectionNumber(display) : -1;
+}
+
+bool windowEventsPending()
+{
+    //XPending also flushes our own requests, which must happen before we wait on the socket
+    if (!deferredEvents.empty())
+        return true;
+    Display* display = subscribedDisplay();
+    return display && XPending(display) > 0;
+}
+
+windowEvents collectWindowEvents()
+{
+    windowEvents result = std::exchange(deferredEvents, {});
+    auto& session = displaySession::get();
+    Display* display = subscribedDisplay();
+    if (!display)
+        return result;
+
+    const Window root = session.root();
+    const Atom clientList = session.atom("_NET_CLIENT_LIST");
+    const Atom wmState = session.atom("_NET_WM_STATE");
+
+    auto markChanged = [&](Window window)
+    {
+        if (std::find(result.changed.begin(), result.changed.end(), window) == result.changed.end())
+            result.changed.push_back(window);
+    };
+
+    while (XPending(display) > 0)
+    {
+        XEvent event;
+        XNextEvent(display, &event);
+        switch (event.type)
+        {
+        case ConfigureNotify:
+            markChanged(event.xconfigure.window);
+            break;
+        case UnmapNotify:
+            markChanged(event.xunmap.window);
+            break;
+        case DestroyNotify:
+            watchedWindows.erase(event.xdestroywindow.window);
+            markChanged(event.xdestroywindow.window);
+            break;
+        case PropertyNotify:
+            if (event.xproperty.window == root)
+            {
+                if (event.xproperty.atom == clientList)
+                    result.clientListChanged = true;
+            }
+            else if (event.xproperty.atom == wmState)
+            {
+                markChanged(event.xproperty.window);
+            }
+            break;
+        default:
+            if (randrEventBase != -1 && (event.type == randrEventBase + RRScreenChangeNotify || event.type == randrEventBase + RRNotify))
+            {
+                //Keeps Xlib's idea of the screen size current
+                XRRUpdateConfiguration(&event);
+                invalidateMonitors();
+                result.monitorsChanged = true;
+            }
+            break;
+        }
+    }
+    return result;
+}
+
+void deferWindowEvents(const windowEvents& events)
+{
+    deferredEvents.merge(events);
+}
+#endif
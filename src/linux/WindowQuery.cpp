@@ -0,0 +1,109 @@
+#ifdef __linux__
+#include "WindowQuery.h"
+#include "DisplaySession.h"
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#include <cstdlib>
+
+std::vector<windowState> queryWindowStates(std::span<const windowHandle> windows)
+{
+    std::vector<windowState> result(windows.size());
+    auto& session = displaySession::get();
+    Display* display = session.handle();
+    if (!display)
+        return result;
+
+    //Requests go out over the same connection as Xlib, so atoms and error handling are shared with the session
+    xcb_connection_t* connection = XGetXCBConnection(display);
+    const xcb_window_t root = session.root();
+    const xcb_atom_t wmState = session.atom("_NET_WM_STATE");
+    const xcb_atom_t wmStateFullscreen = session.atom("_NET_WM_STATE_FULLSCREEN");
+    const xcb_atom_t wmName = session.atom("_NET_WM_NAME");
+
+    struct pendingQuery
+    {
+        xcb_get_geometry_cookie_t geometry{};
+        xcb_translate_coordinates_cookie_t position{};
+        xcb_get_property_cookie_t state{};
+        xcb_get_window_attributes_cookie_t attributes{};
+        xcb_get_property_cookie_t name{};
+    };
+    std::vector<pendingQuery> pending(windows.size());
+
+    //Send every request before waiting on any reply, so the whole batch is pipelined into one round trip
+    for (size_t i = 0; i < windows.size(); ++i)
+    {
+        if (windows[i] == 0)
+            continue;
+        const xcb_window_t window = static_cast<xcb_window_t>(windows[i]);
+        pending[i].geometry = xcb_get_geometry(connection, window);
+        pending[i].position = xcb_translate_coordinates(connection, window, root, 0, 0);
+        if (wmState != None)
+            pending[i].state = xcb_get_property(connection, 0, window, wmState, XCB_ATOM_ATOM, 0, 1024);
+        pending[i].attributes = xcb_get_window_attributes(connection, window);
+        if (wmName != None)
+            pending[i].name = xcb_get_property(connection, 0, window, wmName, XCB_GET_PROPERTY_TYPE_ANY, 0, 1024);
+    }
+
+    for (size_t i = 0; i < windows.size(); ++i)
+    {
+        if (windows[i] == 0)
+            continue;
+        auto& state = result[i];
+        xcb_generic_error_t* error = nullptr;
+
+        //Each reply must be collected (or discarded) even if an earlier one failed, otherwise it is left in the queue
+        auto* geometry = xcb_get_geometry_reply(connection, pending[i].geometry, &error);
+        std::free(error);
+        error = nullptr;
+        auto* position = xcb_translate_coordinates_reply(connection, pending[i].position, &error);
+        std::free(error);
+        error = nullptr;
+        xcb_get_property_reply_t* property = nullptr;
+        if (wmState != None)
+        {
+            property = xcb_get_property_reply(connection, pending[i].state, &error);
+            std::free(error);
+            error = nullptr;
+        }
+        auto* attributes = xcb_get_window_attributes_reply(connection, pending[i].attributes, &error);
+        std::free(error);
+        error = nullptr;
+        xcb_get_property_reply_t* name = nullptr;
+        if (wmName != None)
+        {
+            name = xcb_get_property_reply(connection, pending[i].name, &error);
+            std::free(error);
+        }
+
+        if (geometry && position)
+        {
+            state.exists = true;
+            state.bounds = { position->dst_x, position->dst_y, geometry->width, geometry->height };
+        }
+        if (property && property->type == XCB_ATOM_ATOM && wmStateFullscreen != None)
+        {
+            auto* atoms = static_cast<xcb_atom_t*>(xcb_get_property_value(property));
+            int count = xcb_get_property_value_length(property) / static_cast<int>(sizeof(xcb_atom_t));
+            for (int a = 0; a < count; ++a)
+            {
+                if (atoms[a] == wmStateFullscreen)
+                {
+                    state.fullscreen = true;
+                    break;
+                }
+            }
+        }
+        if (attributes)
+            state.mapped = attributes->map_state == XCB_MAP_STATE_VIEWABLE;
+        if (name)
+            state.title.assign(static_cast<const char*>(xcb_get_property_value(name)), xcb_get_property_value_length(name));
+        std::free(geometry);
+        std::free(position);
+        std::free(property);
+        std::free(attributes);
+        std::free(name);
+    }
+    return result;
+}
+#endif
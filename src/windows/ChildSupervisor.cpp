@@ -0,0 +1,37 @@
+#ifdef _WIN32
+#include "ChildSupervisor.h"
+
+//Processes are started through the shell on Windows, so there are no children to supervise
+
+childSupervisor::~childSupervisor()
+{
+}
+
+childSupervisor& childSupervisor::get()
+{
+    static childSupervisor supervisor;
+    return supervisor;
+}
+
+void childSupervisor::track(processId)
+{
+}
+
+void childSupervisor::reap()
+{
+}
+
+std::vector<processId> childSupervisor::collectExited()
+{
+    return {};
+}
+
+bool childSupervisor::running(processId)
+{
+    return false;
+}
+
+void childSupervisor::signal(processId, int)
+{
+}
+#endif
@@ -0,0 +1,42 @@
+#ifdef _WIN32
+#include "DevTools.h"
+
+//Browsers are started through the shell on Windows, so they can't be handed a pipe and DevTools is never used
+
+devToolsChannel::~devToolsChannel()
+{
+}
+
+bool devToolsChannel::flush()
+{
+    return false;
+}
+
+bool devToolsChannel::receive()
+{
+    return false;
+}
+
+devTools::~devTools()
+{
+}
+
+devTools& devTools::get()
+{
+    static devTools registry;
+    return registry;
+}
+
+std::optional<devToolsPipe> devTools::createPipe()
+{
+    return std::nullopt;
+}
+
+void devTools::open(processId, const devToolsPipe&)
+{
+}
+
+void devTools::update()
+{
+}
+#endif
@@ -0,0 +1,35 @@
+#ifdef _WIN32
+#include "EventLoop.h"
+#include <algorithm>
+#include <thread>
+
+//There are no descriptors to wait on for Windows, so only timers are supported and the loop sleeps until the next one is due
+
+eventLoop::eventLoop()
+{
+}
+
+eventLoop::~eventLoop()
+{
+}
+
+void eventLoop::watch(int, handler, pendingCheck)
+{
+}
+
+void eventLoop::unwatch(int)
+{
+}
+
+void eventLoop::runOnce(std::chrono::milliseconds timeout)
+{
+    auto wakeAt = std::chrono::steady_clock::time_point::max();
+    if (timeout.count() >= 0)
+        wakeAt = std::chrono::steady_clock::now() + timeout;
+    if (auto first = firstTimerDue())
+        wakeAt = std::min(wakeAt, *first);
+    if (wakeAt != std::chrono::steady_clock::time_point::max())
+        std::this_thread::sleep_until(wakeAt);
+    runDueTimers();
+}
+#endif
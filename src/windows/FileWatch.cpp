@@ -0,0 +1,67 @@
+#ifdef _WIN32
+#include "FileWatch.h"
+#include <algorithm>
+
+//There is no change notification on Windows yet, each file is checked once per update regardless of how many watches share it
+
+fileWatchRegistry::~fileWatchRegistry()
+{
+}
+
+fileWatchRegistry& fileWatchRegistry::get()
+{
+    static fileWatchRegistry registry;
+    return registry;
+}
+
+bool fileWatchRegistry::refresh(watchedFile& file)
+{
+    std::error_code ec;
+    auto newTime = std::filesystem::last_write_time(file.path, ec);
+    if (ec || newTime == file.lastWrite)
+        return false;
+    file.lastWrite = newTime;
+    file.version++;
+    return true;
+}
+
+void fileWatchRegistry::watchDirectory(watchedFile&)
+{
+}
+
+std::shared_ptr<const watchedFile> fileWatchRegistry::watch(const std::filesystem::path& path)
+{
+    auto absolute = std::filesystem::absolute(path).lexically_normal();
+    for (auto& weak : files)
+    {
+        if (auto existing = weak.lock(); existing && existing->path == absolute)
+            return existing;
+    }
+
+    auto file = std::make_shared<watchedFile>();
+    file->path = absolute;
+    std::error_code ec;
+    if (auto time = std::filesystem::last_write_time(absolute, ec); !ec)
+        file->lastWrite = time;
+    files.push_back(file);
+    return file;
+}
+
+std::optional<std::chrono::steady_clock::time_point> fileWatchRegistry::nextDeadline() const
+{
+    return std::nullopt;
+}
+
+bool fileWatchRegistry::update()
+{
+    std::erase_if(files, [](const std::weak_ptr<watchedFile>& weak) { return weak.expired(); });
+
+    bool changed = false;
+    for (auto& weak : files)
+    {
+        if (auto file = weak.lock())
+            changed |= refresh(*file);
+    }
+    return changed;
+}
+#endif
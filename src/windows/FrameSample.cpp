@@ -0,0 +1,66 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include "FrameSample.h"
+
+//Copies each area of the screen into a bitmap, and gives the pixels to the reader while the bitmap is still there
+//Areas that can't be read are skipped, and the reader is told nothing of them
+template <typename Reader>
+static void readAreas(std::span<const rect> areas, Reader&& reader)
+{
+    HDC screen = GetDC(NULL);
+    if (!screen)
+        return;
+    HDC memory = CreateCompatibleDC(screen);
+    for (size_t i = 0; i < areas.size(); ++i)
+    {
+        const auto& area = areas[i];
+        if (!memory || area.width <= 0 || area.height <= 0)
+            continue;
+
+        //Top down 32 bit pixels, so rows can be read in order
+        BITMAPINFO info = { 0 };
+        info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        info.bmiHeader.biWidth = area.width;
+        info.bmiHeader.biHeight = -area.height;
+        info.bmiHeader.biPlanes = 1;
+        info.bmiHeader.biBitCount = 32;
+        info.bmiHeader.biCompression = BI_RGB;
+        void* pixels = nullptr;
+        HBITMAP bitmap = CreateDIBSection(screen, &info, DIB_RGB_COLORS, &pixels, NULL, 0);
+        if (!bitmap)
+            continue;
+        HGDIOBJ previous = SelectObject(memory, bitmap);
+        if (BitBlt(memory, 0, 0, area.width, area.height, screen, area.left, area.top, SRCCOPY))
+        {
+            GdiFlush();
+            reader(i, static_cast<const std::uint8_t*>(pixels), area.width, area.height, static_cast<std::ptrdiff_t>(area.width) * 4);
+        }
+        SelectObject(memory, previous);
+        DeleteObject(bitmap);
+    }
+    if (memory)
+        DeleteDC(memory);
+    ReleaseDC(NULL, screen);
+}
+
+std::vector<std::optional<frameSample>> sampleFrames(std::span<const rect> areas)
+{
+    std::vector<std::optional<frameSample>> result(areas.size());
+    readAreas(areas, [&](size_t i, const std::uint8_t* pixels, int width, int height, std::ptrdiff_t stride)
+    {
+        result[i] = summariseFrame(pixels, width, height, stride);
+    });
+    return result;
+}
+
+std::optional<capturedFrame> captureArea(rect area)
+{
+    std::optional<capturedFrame> result;
+    readAreas({ &area, 1 }, [&](size_t, const std::uint8_t* pixels, int width, int height, std::ptrdiff_t stride)
+    {
+        result = capturedFrame::copy(pixels, width, height, stride);
+    });
+    return result;
+}
+#endif
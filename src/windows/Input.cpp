@@ -0,0 +1,141 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include "InputQueue.h"
+#include <vector>
+
+//Inputs are collected here by sendInput, and given to SendInput together by flushInput
+static std::vector<INPUT> pending;
+
+static void addKey(WORD vkCode, bool press)
+{
+    INPUT input = { 0 };
+    input.type = INPUT_KEYBOARD;
+    input.ki.wVk = vkCode;
+    input.ki.dwFlags = press ? 0 : KEYEVENTF_KEYUP;
+    pending.push_back(input);
+}
+
+//Unicode characters are sent as UTF-16, which the window receives as typed characters whatever the keyboard layout
+static void addCharacter(char32_t character)
+{
+    auto addUnit = [](WORD unit)
+    {
+        INPUT input = { 0 };
+        input.type = INPUT_KEYBOARD;
+        input.ki.wScan = unit;
+        input.ki.dwFlags = KEYEVENTF_UNICODE;
+        pending.push_back(input);
+        input.ki.dwFlags |= KEYEVENTF_KEYUP;
+        pending.push_back(input);
+    };
+    //Line breaks and tabs are sent as their keys, as pages handle those rather than the characters
+    if (character == U'\n' || character == U'\r')
+    {
+        addKey(VK_RETURN, true);
+        addKey(VK_RETURN, false);
+        return;
+    }
+    if (character == U'\t')
+    {
+        addKey(VK_TAB, true);
+        addKey(VK_TAB, false);
+        return;
+    }
+    if (character < 0x20 || character > 0x10FFFF)
+        return;
+    if (character < 0x10000)
+    {
+        addUnit(static_cast<WORD>(character));
+        return;
+    }
+    character -= 0x10000;
+    addUnit(static_cast<WORD>(0xD800 + (character >> 10)));
+    addUnit(static_cast<WORD>(0xDC00 + (character & 0x3FF)));
+}
+
+bool focusForInput(processId pid, windowHandle target)
+{
+    if (!target || !IsWindow(target))
+        return false;
+
+    //Give the browser a moment to be ready for input, without holding up the kiosk for long if it is busy
+    if (HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, pid))
+    {
+        WaitForInputIdle(hProcess, 100);
+        CloseHandle(hProcess);
+    }
+
+    //Restore and give focus
+    if (IsIconic(target))
+    {
+        ShowWindow(target, SW_RESTORE);
+    }
+    SetForegroundWindow(target);
+    SetFocus(target);
+    return true;
+}
+
+bool sendInput(windowHandle target, const inputAction& action)
+{
+    switch (action.type)
+    {
+    case inputAction::kind::key:
+        //If Shift, Control, or Alt is pressed, send their down events
+        if (action.shift)
+            addKey(VK_SHIFT, true);
+        if (action.control)
+            addKey(VK_CONTROL, true);
+        if (action.alt)
+            addKey(VK_MENU, true);
+        //Send a down, then an up (otherwise the window will think we're holding the key)
+        addKey(action.key, true);
+        addKey(action.key, false);
+        if (action.shift)
+            addKey(VK_SHIFT, false);
+        if (action.control)
+            addKey(VK_CONTROL, false);
+        if (action.alt)
+            addKey(VK_MENU, false);
+        break;
+    case inputAction::kind::character:
+        addCharacter(action.character);
+        break;
+    case inputAction::kind::click:
+        //Clicks go straight to the window, so anything pending is sent first to keep the order
+        flushInput();
+        switch (action.button)
+        {
+        case 1: //Left click
+            SendMessage(target, WM_LBUTTONDOWN, MK_LBUTTON, MAKELPARAM(action.x, action.y));
+            SendMessage(target, WM_LBUTTONUP, MK_LBUTTON, MAKELPARAM(action.x, action.y));
+            break;
+        case 2: //Right click
+            SendMessage(target, WM_RBUTTONDOWN, MK_RBUTTON, MAKELPARAM(action.x, action.y));
+            SendMessage(target, WM_RBUTTONUP, MK_RBUTTON, MAKELPARAM(action.x, action.y));
+            break;
+        case 3: //Middle click
+            SendMessage(target, WM_MBUTTONDOWN, MK_MBUTTON, MAKELPARAM(action.x, action.y));
+            SendMessage(target, WM_MBUTTONUP, MK_MBUTTON, MAKELPARAM(action.x, action.y));
+            break;
+        default:
+            //Invalid button type
+            break;
+        }
+        break;
+    }
+    return true;
+}
+
+void flushInput()
+{
+    if (!pending.empty())
+        SendInput(static_cast<UINT>(pending.size()), pending.data(), sizeof(INPUT));
+    pending.clear();
+}
+
+void releaseInput()
+{
+    //Nothing is changed to send input on Windows
+}
+#endif
@@ -0,0 +1,46 @@
+#ifdef _WIN32
+#include "Metrics.h"
+#include <iostream>
+#include "osmanip/manipulators/colsty.hpp"
+
+std::uint64_t windowSystemRequests()
+{
+    //Windows has no request stream to count
+    return 0;
+}
+
+metricsServer::~metricsServer() = default;
+
+metricsServer& metricsServer::get()
+{
+    static metricsServer server;
+    return server;
+}
+
+void metricsServer::closeAll()
+{
+}
+
+void metricsServer::accept(int)
+{
+}
+
+bool metricsServer::serve(connection&)
+{
+    return false;
+}
+
+void metricsServer::configure(const std::string& socketPath, int port)
+{
+    if (socketPath == openSocket && port == openPort)
+        return;
+    openSocket = socketPath;
+    openPort = port;
+    if (!socketPath.empty() || port > 0)
+        std::cout << osm::feat(osm::col, "orange") << "Metrics can only be served on Linux.\n" << osm::feat(osm::rst, "all");
+}
+
+void metricsServer::update()
+{
+}
+#endif
@@ -17,8 +17,12 @@ BOOL CALLBACK MonitorEnumProc(HMONITOR, HDC, LPRECT lprcMonitor, LPARAM dwData)
     return TRUE;
 }
 
+static std::vector<rect> cachedMonitors;
+static size_t monitorGeneration = 0;
+
 //Returns an ordered list of rects representing monitor spaces, ordered left to right, top to bottom
-std::vector<rect> getMonitors()
+//Layout changes are not reported to us here, so this always queries, only keeping the result to spot changes
+const std::vector<rect>& getMonitors()
 {
     std::vector<rect> result;
     if (!EnumDisplayMonitors(NULL, NULL, MonitorEnumProc, reinterpret_cast<LPARAM>(&result)))
@@ -30,6 +34,25 @@ std::vector<rect> getMonitors()
             //Compare left, unless equal then compare top
             return a.left == b.left ? a.top < b.top : a.left < b.left;
         });
-    return result;
+    if (result != cachedMonitors)
+    {
+        cachedMonitors = std::move(result);
+        monitorGeneration++;
+    }
+    return cachedMonitors;
+}
+
+size_t getMonitorGeneration()
+{
+    return monitorGeneration;
+}
+
+int getSystemMonitorIndex(int monitor)
+{
+    return monitor;
+}
+
+void invalidateMonitors()
+{
 }
 #endif
\ No newline at end of file
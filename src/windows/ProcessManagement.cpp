@@ -8,18 +8,26 @@
 #include <algorithm>
 #include <ranges>
 #include "Settings.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include <iostream>
 #define NOMINMAX
 #include <Windows.h>
 #undef RGB //Windows leaks this macro and it conflicts with osmanip
 
-void createProcess(const std::string& path, const std::string& args)
+processId createProcess(const std::string& path, const std::string& args, std::span<const std::string> extraArgs, std::span<const int>)
 {
-    HINSTANCE hInstance = ShellExecuteA(nullptr, "open", path.c_str(), (args + " --new-window " + appSettings::get().startArgs).c_str(), nullptr, SW_SHOWDEFAULT);
+    auto commandLine = args + " --new-window " + appSettings::get().startArgs;
+    for (const auto& arg : extraArgs)
+        commandLine += " \"" + arg + "\"";
+    HINSTANCE hInstance = ShellExecuteA(nullptr, "open", path.c_str(), commandLine.c_str(), nullptr, SW_SHOWDEFAULT);
     if (reinterpret_cast<std::uintptr_t>(hInstance) <= HINSTANCE_ERROR)
     {
         throw std::exception("Failed to start process.\n");
     }
+    countLaunch();
+    //ShellExecute doesn't tell us the process it started
+    return 0;
 }
 
 std::vector<processId> getActiveProcesses()
@@ -119,6 +127,7 @@ std::vector<std::pair<processId, windowHandle>> getMostRecentProcessesWithName(c
 
 void closeAllExisting()
 {
+    countCloseAll();
     std::cout << osm::feat(osm::col, "orange") << "Closing all instances of " << appSettings::get().processName << ".\n" << osm::feat(osm::rst, "all");
     auto processes = getMostRecentProcessesWithName(appSettings::get().processName);
     for (auto& i : processes)
@@ -128,22 +137,77 @@ void closeAllExisting()
 std::optional<std::pair<processId, windowHandle>> startProcess(const std::string& url, std::span<const windowHandle> existing, windowHandle self)
 {
     createProcess(appSettings::get().executableName, url);
-    std::this_thread::sleep_for(std::chrono::seconds(appSettings::get().loadTime));
-    auto instances = getMostRecentProcessesWithName(appSettings::get().processName);
-    std::erase_if(instances, [&](const auto& l) 
-        { return l.second != self && std::find(existing.begin(), existing.end(), l.second) != existing.end(); });
+    //Look for the window as soon as it could be there, rather than waiting a fixed time that is too long for most pages and too short for some
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(appSettings::get().launchTimeout);
+    std::vector<std::pair<processId, windowHandle>> instances;
+    while (true)
+    {
+        instances = getMostRecentProcessesWithName(appSettings::get().processName);
+        std::erase_if(instances, [&](const auto& l) 
+            { return l.second != self && std::find(existing.begin(), existing.end(), l.second) != existing.end(); });
+        if (!instances.empty() || std::chrono::steady_clock::now() >= deadline)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
     if (instances.size() == 0)
     {
-        std::cout << osm::feat(osm::col, "orange") << "Failed to register process and will reset. Consider increasing LOADTIME.\n" << osm::feat(osm::rst, "all");
+        countFailedRegistration();
+        std::cout << osm::feat(osm::col, "orange") << "Failed to register process and will reset. Consider increasing LAUNCHTIMEOUT.\n" << osm::feat(osm::rst, "all");
         closeAllExisting();
         return std::nullopt;
     }
     if (instances.size() > 1)
     {
+        countFailedRegistration();
         std::cout << osm::feat(osm::col, "orange") << "Failed to register process and will reset. Too many processes were found.\n" << osm::feat(osm::rst, "all");
         closeAllExisting();
         return std::nullopt;
     }
     return instances[0];
 }
+
+std::optional<pendingLaunch> beginLaunch(const std::string&, std::span<const std::string>)
+{
+    //New windows can only be told apart by waiting for each in turn
+    return std::nullopt;
+}
+
+std::vector<std::optional<std::pair<processId, windowHandle>>> findLaunchedWindows(std::span<const pendingLaunch> launches, std::span<const windowHandle>)
+{
+    return std::vector<std::optional<std::pair<processId, windowHandle>>>(launches.size());
+}
+
+std::vector<std::string> offscreenLaunchArgs()
+{
+    return {};
+}
+
+void closeLaunch(const pendingLaunch&)
+{
+}
+
+void minimiseWindow(windowHandle handle)
+{
+    ShowWindow(handle, SW_MINIMIZE);
+}
+
+void restoreWindow(windowHandle handle)
+{
+    ShowWindow(handle, SW_RESTORE);
+}
+
+std::vector<std::optional<std::pair<processId, windowHandle>>> startProcesses(std::span<const std::string> urls, std::span<const windowHandle> existing)
+{
+    //Without a way to tell new windows apart, processes are started one at a time
+    std::vector<std::optional<std::pair<processId, windowHandle>>> result;
+    std::vector<windowHandle> known(existing.begin(), existing.end());
+    for (const auto& url : urls)
+    {
+        traceSpan span("launch browser", url);
+        result.push_back(startProcess(url, known, 0));
+        if (result.back())
+            known.push_back(result.back()->second);
+    }
+    return result;
+}
 #endif
\ No newline at end of file
@@ -0,0 +1,18 @@
+#ifdef _WIN32
+#include "Trace.h"
+
+//There is no signal to listen for, the trace is saved from lua instead
+void listenForTraceSignal()
+{
+}
+
+int traceSignalSource()
+{
+    return -1;
+}
+
+bool takeTraceSignal()
+{
+    return false;
+}
+#endif
@@ -0,0 +1,28 @@
+#ifdef _WIN32
+#include "WindowEvents.h"
+
+//Window events are not implemented on Windows, the kiosk falls back to checking windows every tick
+
+void watchWindow(windowHandle)
+{
+}
+
+int windowEventSource()
+{
+    return -1;
+}
+
+bool windowEventsPending()
+{
+    return false;
+}
+
+windowEvents collectWindowEvents()
+{
+    return {};
+}
+
+void deferWindowEvents(const windowEvents&)
+{
+}
+#endif
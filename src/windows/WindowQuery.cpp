@@ -0,0 +1,24 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#undef RGB //Windows leaks this macro and it conflicts with osmanip
+#include "WindowQuery.h"
+
+std::vector<windowState> queryWindowStates(std::span<const windowHandle> windows)
+{
+    std::vector<windowState> result(windows.size());
+    for (size_t i = 0; i < windows.size(); ++i)
+    {
+        RECT windowBounds;
+        if (windows[i] && IsWindow(windows[i]) && GetWindowRect(windows[i], &windowBounds))
+        {
+            result[i].exists = true;
+            result[i].bounds = { windowBounds.left, windowBounds.top, windowBounds.right - windowBounds.left, windowBounds.bottom - windowBounds.top };
+            result[i].mapped = IsWindowVisible(windows[i]) != FALSE;
+            char title[512];
+            result[i].title.assign(title, GetWindowTextA(windows[i], title, sizeof(title)));
+        }
+    }
+    return result;
+}
+#endif
@@ -1,8 +1,8 @@
 add_rules("mode.debug", "mode.release")
 
-add_requires("luajit", "sol2", "osmanip")
+add_requires("luajit", "sol2", "osmanip", "zlib")
 if is_plat("linux") then
-    add_requires("libx11", "libxinerama", "libxtst")
+    add_requires("libx11", "libxcb", "libxinerama", "libxrandr", "libxtst", "libxext")
 end
 
 set_languages("c++20")
@@ -14,9 +14,10 @@ target("Kiosk")
     add_includedirs("include")
     add_headerfiles("include/**.h")
     add_files("src/**.cpp")
-    add_packages("luajit", "sol2", "osmanip")
+    add_packages("luajit", "sol2", "osmanip", "zlib")
     if is_plat("linux") then
-        add_packages("libx11", "libxinerama", "libxtst")
+        add_packages("libx11", "libxcb", "libxinerama", "libxrandr", "libxtst", "libxext")
+        add_links("X11-xcb")
     end
     set_warnings("allextra", "error")
     if is_plat("windows") then